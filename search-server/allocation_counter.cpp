@@ -0,0 +1,65 @@
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+
+namespace {
+
+std::atomic<size_t> allocation_count = 0;
+std::atomic<size_t> allocated_bytes = 0;
+std::atomic<size_t> peak_allocated_bytes = 0;
+
+}
+
+AllocationStats GetAllocationStats() {
+	return { allocation_count, allocated_bytes, peak_allocated_bytes };
+}
+
+void ResetPeakAllocatedBytes() {
+	peak_allocated_bytes = allocated_bytes.load();
+}
+
+#ifdef SEARCH_SERVER_COUNT_ALLOCATIONS
+
+namespace {
+
+void* Allocate(size_t size) {
+	++allocation_count;
+	void* ptr = malloc(size);
+	if (ptr) {
+		const size_t bytes = allocated_bytes += malloc_usable_size(ptr);
+		size_t peak = peak_allocated_bytes;
+		while (bytes > peak && !peak_allocated_bytes.compare_exchange_weak(peak, bytes)) {
+		}
+	}
+	return ptr;
+}
+
+void Deallocate(void* ptr) {
+	if (ptr) {
+		allocated_bytes -= malloc_usable_size(ptr);
+	}
+	free(ptr);
+}
+
+}
+
+void* operator new(size_t size) {
+	if (void* ptr = Allocate(size)) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+	Deallocate(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+	Deallocate(ptr);
+}
+
+#endif
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+
+// Heap use seen through the global operator new and delete. They are replaced
+// only with -DSEARCH_SERVER_COUNT_ALLOCATIONS, since counting every allocation
+// skews the timings of everything else; otherwise the counters stay zero.
+struct AllocationStats {
+	size_t count = 0;
+	size_t bytes = 0;
+	size_t peak_bytes = 0;
+};
+
+AllocationStats GetAllocationStats();
+
+// Restarts peak_bytes from the bytes allocated now.
+void ResetPeakAllocatedBytes();
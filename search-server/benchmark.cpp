@@ -0,0 +1,885 @@
+#include "benchmark.h"
+#include "allocation_counter.h"
+#include "concurrent_search_server.h"
+#include "corpus_generator.h"
+#include "index_snapshot.h"
+#include "process_queries.h"
+#include "query_cache.h"
+#include "query_metrics.h"
+#include "remove_duplicates.h"
+#include "search_server.h"
+#include "segmented_search_server.h"
+#include "shard_router.h"
+#include "sharded_search_server.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if __has_include(<tbb/global_control.h>)
+#include <tbb/global_control.h>
+#define HAS_TBB_GLOBAL_CONTROL
+#endif
+
+namespace {
+
+// Every DUPLICATE_PERIOD-th document of the duplicates corpus repeats the one before it.
+const size_t DUPLICATE_PERIOD = 10;
+// Removal benchmarks remove every REMOVAL_PERIOD-th document.
+const size_t REMOVAL_PERIOD = 10;
+// 70-word queries cost tens of times more than short ones, so fewer are run.
+const size_t LONG_QUERY_DIVISOR = 10;
+// Documents per results page in the MatchDocuments benchmarks.
+const size_t PAGE_SIZE = 20;
+// Each query matched against every document costs as much as hundreds of pages.
+const size_t FULL_MATCH_QUERY_DIVISOR = 100;
+// Similarity threshold of the near-duplicate benchmark.
+const double NEAR_DUPLICATE_SIMILARITY = 0.8;
+// Enough digits for checksums to expose changes in relevance.
+const int MACHINE_READABLE_PRECISION = 12;
+// Cached queries are requested this many times each on average, with Zipf(1) popularity.
+const size_t CACHE_REQUESTS_PER_QUERY = 5;
+const size_t QUERY_CACHE_CAPACITY = 2048;
+// One skewed query in HEAVY_QUERY_PERIOD has HEAVY_QUERY_WORD_COUNT words, the rest three.
+const size_t HEAVY_QUERY_PERIOD = 20;
+const int HEAVY_QUERY_WORD_COUNT = 400;
+// The concurrent writer publishes after every PUBLISH_INTERVAL updates.
+const size_t PUBLISH_INTERVAL = 256;
+// Sharded benchmarks double the shard count from 1 up to this.
+const size_t MAX_BENCHMARK_SHARDS = 4;
+const std::chrono::seconds BENCHMARK_SHARD_TIMEOUT(10);
+// Pool size of the nested batch benchmark.
+const size_t NESTED_BENCHMARK_THREADS = 4;
+
+// VmHWM of /proc/self/status, or the lifetime peak from getrusage where that is missing.
+size_t GetPeakMemory() {
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.compare(0, 6, "VmHWM:") == 0) {
+			return std::stoull(line.substr(6)) * 1024;
+		}
+	}
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
+
+// Lowers VmHWM to the current resident size; a no-op without /proc.
+void ResetPeakMemory() {
+	std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+size_t ParseCount(std::string_view name, std::string_view value) {
+	size_t position = 0;
+	const std::string text(value);
+	try {
+		const unsigned long long count = std::stoull(text, &position);
+		if (position == text.size() && text[0] != '-') {
+			return static_cast<size_t>(count);
+		}
+	}
+	catch (const std::exception&) {
+	}
+	throw std::invalid_argument("Неверное значение " + std::string(name) + ": " + text);
+}
+
+double ParseReal(std::string_view name, std::string_view value) {
+	size_t position = 0;
+	const std::string text(value);
+	try {
+		const double real = std::stod(text, &position);
+		if (position == text.size() && real >= 0) {
+			return real;
+		}
+	}
+	catch (const std::exception&) {
+	}
+	throw std::invalid_argument("Неверное значение " + std::string(name) + ": " + text);
+}
+
+// Starts shard_count processes of this program in --shard mode and returns their sockets.
+std::vector<std::string> StartShardProcesses(const std::string& stop_words, size_t shard_count, std::vector<pid_t>& processes) {
+	std::vector<std::string> socket_paths;
+	for (size_t shard = 0; shard < shard_count; ++shard) {
+		socket_paths.push_back((std::filesystem::temp_directory_path() / ("search_shard_" + std::to_string(getpid()) + "_" + std::to_string(shard) + ".sock")).string());
+		const std::string mode = "--shard";
+		char* const arguments[] = { const_cast<char*>("search_server"), const_cast<char*>(mode.c_str()), const_cast<char*>(socket_paths.back().c_str()), const_cast<char*>(stop_words.c_str()), nullptr };
+		pid_t process;
+		if (posix_spawn(&process, "/proc/self/exe", nullptr, nullptr, arguments, environ) != 0) {
+			throw std::runtime_error("Не удалось запустить шард");
+		}
+		processes.push_back(process);
+	}
+	return socket_paths;
+}
+
+// "p50 ... us, p99 ... us, max ... us" of latencies given in seconds.
+std::string DescribeLatencies(std::vector<double> latencies) {
+	if (latencies.empty()) {
+		return "no samples";
+	}
+	std::sort(latencies.begin(), latencies.end());
+	const auto percentile = [&latencies](double fraction) {
+		return latencies[static_cast<size_t>(fraction * (latencies.size() - 1))] * 1e6;
+	};
+	std::ostringstream description;
+	description << "p50 " << percentile(0.5) << " us, p99 " << percentile(0.99) << " us, max " << percentile(1) << " us";
+	return description.str();
+}
+
+std::string EscapeJson(std::string_view text) {
+	std::string escaped;
+	for (const char c : text) {
+		if (c == '"' || c == '\\') {
+			escaped.push_back('\\');
+		}
+		escaped.push_back(c);
+	}
+	return escaped;
+}
+
+class BenchmarkRunner {
+public:
+	explicit BenchmarkRunner(const BenchmarkOptions& options)
+		: options_(options) {
+	}
+
+	bool IsSelected(const std::string& name) const {
+		return name.find(options_.filter) != std::string::npos;
+	}
+
+	// setup() runs untimed before every round; run() is timed and returns a checksum.
+	template <typename Setup, typename Run>
+	void Measure(const std::string& name, size_t item_count, Setup setup, Run run) {
+		if (!IsSelected(name)) {
+			return;
+		}
+		BenchmarkResult result;
+		result.name = name;
+		result.item_count = item_count;
+		ResetPeakMemory();
+		for (int round = 0; round < options_.warmup + options_.repetitions; ++round) {
+			setup();
+			const auto start_time = std::chrono::steady_clock::now();
+			const double checksum = run();
+			const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start_time;
+			if (round >= options_.warmup) {
+				result.seconds.push_back(seconds.count());
+				result.checksum = checksum;
+			}
+		}
+		result.peak_memory = GetPeakMemory();
+		std::cerr << name << ": " << result.GetMedian() * 1000 << " ms" << std::endl;
+		results_.push_back(std::move(result));
+	}
+
+	template <typename Run>
+	void Measure(const std::string& name, size_t item_count, Run run) {
+		Measure(name, item_count, [] {}, run);
+	}
+
+	std::vector<BenchmarkResult>& GetResults() {
+		return results_;
+	}
+
+private:
+	const BenchmarkOptions& options_;
+	std::vector<BenchmarkResult> results_;
+};
+
+double SumRelevance(const std::vector<Document>& documents) {
+	double total_relevance = 0;
+	for (const Document& document : documents) {
+		total_relevance += document.relevance;
+	}
+	return total_relevance;
+}
+
+template <typename Find>
+double RunQueries(const std::vector<std::string>& queries, Find find) {
+	double total_relevance = 0;
+	for (const std::string& query : queries) {
+		total_relevance += SumRelevance(find(query));
+	}
+	return total_relevance;
+}
+
+std::vector<RawDocument> MakeRawDocuments(const std::vector<std::string>& texts) {
+	std::vector<RawDocument> documents;
+	documents.reserve(texts.size());
+	for (size_t i = 0; i < texts.size(); ++i) {
+		documents.push_back({ static_cast<int>(i), texts[i], DocumentStatus::ACTUAL, { 1, 2, 3 } });
+	}
+	return documents;
+}
+
+void PrintText(const std::vector<BenchmarkResult>& results, std::ostream& output) {
+	for (const BenchmarkResult& result : results) {
+		output << result.name << ": median " << result.GetMedian() * 1000 << " ms, mean " << result.GetMean() * 1000
+			<< " ms +- " << result.GetStandardDeviation() * 1000 << ", min " << result.GetMin() * 1000 << " ms, max " << result.GetMax() * 1000
+			<< " ms, " << result.GetItemsPerSecond() << " items/s, peak " << result.peak_memory / (1024 * 1024) << " MiB, checksum " << result.checksum << std::endl;
+	}
+}
+
+void PrintCsv(const std::vector<BenchmarkResult>& results, std::ostream& output) {
+	const std::streamsize precision = output.precision(MACHINE_READABLE_PRECISION);
+	output << "name,items,repetitions,median_s,mean_s,stddev_s,min_s,max_s,items_per_s,peak_memory_bytes,checksum" << std::endl;
+	for (const BenchmarkResult& result : results) {
+		output << result.name << ',' << result.item_count << ',' << result.seconds.size() << ',' << result.GetMedian() << ','
+			<< result.GetMean() << ',' << result.GetStandardDeviation() << ',' << result.GetMin() << ',' << result.GetMax() << ','
+			<< result.GetItemsPerSecond() << ',' << result.peak_memory << ',' << result.checksum << std::endl;
+	}
+	output.precision(precision);
+}
+
+void PrintJson(const BenchmarkOptions& options, const std::vector<BenchmarkResult>& results, std::ostream& output) {
+	const std::streamsize precision = output.precision(MACHINE_READABLE_PRECISION);
+	output << "{\"options\": {\"documents\": " << options.document_count << ", \"dictionary\": " << options.dictionary_size
+		<< ", \"document_words\": " << options.document_word_count << ", \"queries\": " << options.query_count
+		<< ", \"corpus_zipf\": " << options.corpus_zipf_exponent << ", \"warmup\": " << options.warmup
+		<< ", \"repetitions\": " << options.repetitions << ", \"seed\": " << options.seed
+		<< ", \"filter\": \"" << EscapeJson(options.filter) << "\"}," << std::endl << "\"benchmarks\": [";
+	for (size_t i = 0; i < results.size(); ++i) {
+		const BenchmarkResult& result = results[i];
+		output << (i > 0 ? "," : "") << std::endl << "{\"name\": \"" << EscapeJson(result.name) << "\", \"items\": " << result.item_count
+			<< ", \"seconds\": [";
+		for (size_t repetition = 0; repetition < result.seconds.size(); ++repetition) {
+			output << (repetition > 0 ? ", " : "") << result.seconds[repetition];
+		}
+		output << "], \"median_s\": " << result.GetMedian() << ", \"mean_s\": " << result.GetMean()
+			<< ", \"stddev_s\": " << result.GetStandardDeviation() << ", \"min_s\": " << result.GetMin() << ", \"max_s\": " << result.GetMax()
+			<< ", \"items_per_s\": " << result.GetItemsPerSecond() << ", \"peak_memory_bytes\": " << result.peak_memory
+			<< ", \"checksum\": " << result.checksum << "}";
+	}
+	output << std::endl << "]}" << std::endl;
+	output.precision(precision);
+}
+
+}
+
+BenchmarkOptions ParseBenchmarkOptions(const std::vector<std::string_view>& arguments) {
+	BenchmarkOptions options;
+	for (size_t i = 0; i < arguments.size(); i += 2) {
+		const std::string_view name = arguments[i];
+		if (i + 1 == arguments.size()) {
+			throw std::invalid_argument("Нет значения " + std::string(name));
+		}
+		const std::string_view value = arguments[i + 1];
+		if (name == "--documents") {
+			options.document_count = ParseCount(name, value);
+		}
+		else if (name == "--dictionary") {
+			options.dictionary_size = static_cast<int>(ParseCount(name, value));
+		}
+		else if (name == "--document-words") {
+			options.document_word_count = static_cast<int>(ParseCount(name, value));
+		}
+		else if (name == "--queries") {
+			options.query_count = ParseCount(name, value);
+		}
+		else if (name == "--corpus-zipf") {
+			options.corpus_zipf_exponent = ParseReal(name, value);
+		}
+		else if (name == "--warmup") {
+			options.warmup = static_cast<int>(ParseCount(name, value));
+		}
+		else if (name == "--repetitions") {
+			options.repetitions = static_cast<int>(ParseCount(name, value));
+		}
+		else if (name == "--seed") {
+			options.seed = static_cast<uint32_t>(ParseCount(name, value));
+		}
+		else if (name == "--filter") {
+			options.filter = value;
+		}
+		else if (name == "--format") {
+			if (value == "text") {
+				options.format = BenchmarkFormat::TEXT;
+			}
+			else if (value == "json") {
+				options.format = BenchmarkFormat::JSON;
+			}
+			else if (value == "csv") {
+				options.format = BenchmarkFormat::CSV;
+			}
+			else {
+				throw std::invalid_argument("Неверный формат: " + std::string(value));
+			}
+		}
+		else {
+			throw std::invalid_argument("Неизвестный параметр: " + std::string(name));
+		}
+	}
+	if (options.document_count == 0 || options.dictionary_size == 0 || options.document_word_count == 0 || options.query_count == 0 || options.repetitions == 0) {
+		throw std::invalid_argument("Размеры должны быть положительными");
+	}
+	return options;
+}
+
+std::string GetBenchmarkUsage() {
+	return "--bench [--documents N] [--dictionary N] [--document-words N] [--queries N] [--corpus-zipf S]\n"
+		"        [--warmup N] [--repetitions N] [--seed N] [--filter TEXT] [--format text|json|csv]";
+}
+
+double BenchmarkResult::GetMin() const {
+	return seconds.empty() ? 0 : *std::min_element(seconds.begin(), seconds.end());
+}
+
+double BenchmarkResult::GetMax() const {
+	return seconds.empty() ? 0 : *std::max_element(seconds.begin(), seconds.end());
+}
+
+double BenchmarkResult::GetMedian() const {
+	if (seconds.empty()) {
+		return 0;
+	}
+	std::vector<double> sorted = seconds;
+	std::sort(sorted.begin(), sorted.end());
+	const size_t middle = sorted.size() / 2;
+	return sorted.size() % 2 == 1 ? sorted[middle] : (sorted[middle - 1] + sorted[middle]) / 2;
+}
+
+double BenchmarkResult::GetMean() const {
+	return seconds.empty() ? 0 : std::accumulate(seconds.begin(), seconds.end(), 0.0) / seconds.size();
+}
+
+double BenchmarkResult::GetStandardDeviation() const {
+	if (seconds.size() < 2) {
+		return 0;
+	}
+	const double mean = GetMean();
+	double squares = 0;
+	for (const double value : seconds) {
+		squares += (value - mean) * (value - mean);
+	}
+	return std::sqrt(squares / (seconds.size() - 1));
+}
+
+double BenchmarkResult::GetItemsPerSecond() const {
+	const double median = GetMedian();
+	return median > 0 ? item_count / median : 0;
+}
+
+std::vector<BenchmarkResult> RunBenchmarks(const BenchmarkOptions& options, std::ostream& output) {
+	std::mt19937 generator(options.seed);
+	const std::vector<std::string> dictionary = GenerateDictionary(generator, options.dictionary_size, 10);
+	const ZipfDistribution zipf(dictionary.size(), 1.0);
+	std::vector<std::string> texts;
+	texts.reserve(options.document_count);
+	const ZipfDistribution corpus_zipf(dictionary.size(), options.corpus_zipf_exponent);
+	for (size_t i = 0; i < options.document_count; ++i) {
+		texts.push_back(GenerateQuery(generator, dictionary, options.document_word_count, 0, options.corpus_zipf_exponent > 0 ? &corpus_zipf : nullptr));
+	}
+	const std::string& stop_words = dictionary[0];
+	const std::vector<RawDocument> documents = MakeRawDocuments(texts);
+
+	std::vector<std::string> duplicate_texts = texts;
+	for (size_t i = DUPLICATE_PERIOD; i < duplicate_texts.size(); i += DUPLICATE_PERIOD) {
+		duplicate_texts[i] = duplicate_texts[i - 1];
+	}
+	const std::vector<RawDocument> duplicate_documents = MakeRawDocuments(duplicate_texts);
+	std::vector<int> removed_ids;
+	for (size_t i = 0; i < documents.size(); i += REMOVAL_PERIOD) {
+		removed_ids.push_back(documents[i].id);
+	}
+
+	const auto make_queries = [&](size_t count, int word_count, double minus_prob) {
+		std::vector<std::string> queries;
+		queries.reserve(count);
+		for (size_t i = 0; i < count; ++i) {
+			queries.push_back(GenerateQuery(generator, dictionary, word_count, minus_prob));
+		}
+		return queries;
+	};
+	const size_t long_query_count = std::max<size_t>(1, options.query_count / LONG_QUERY_DIVISOR);
+	const std::vector<std::string> one_word_queries = make_queries(options.query_count, 1, 0);
+	const std::vector<std::string> three_word_queries = make_queries(options.query_count, 3, 0);
+	const std::vector<std::string> ten_word_queries = make_queries(options.query_count, 10, 0);
+	const std::vector<std::string> long_queries = make_queries(long_query_count, 70, 0);
+	const std::vector<std::string> minus_queries = make_queries(options.query_count, 10, 0.25);
+	std::vector<std::string> zipf_queries;
+	for (size_t i = 0; i < options.query_count; ++i) {
+		zipf_queries.push_back(GenerateQuery(generator, dictionary, 3, 0, &zipf));
+	}
+	// Repeats of the three-word queries for the cache; popular ones come up again and again.
+	const ZipfDistribution query_popularity(three_word_queries.size(), 1.0);
+	std::vector<std::string> repeated_queries;
+	for (size_t i = 0; i < three_word_queries.size() * CACHE_REQUESTS_PER_QUERY; ++i) {
+		repeated_queries.push_back(three_word_queries[query_popularity(generator)]);
+	}
+	// Mostly light queries with a few heavy ones, to show how the executor balances them.
+	std::vector<std::string> skewed_queries;
+	for (size_t i = 0; i < options.query_count; ++i) {
+		skewed_queries.push_back(GenerateQuery(generator, dictionary, i % HEAVY_QUERY_PERIOD == 0 ? HEAVY_QUERY_WORD_COUNT : 3, 0.05));
+	}
+
+	BenchmarkRunner runner(options);
+	const auto split = [](const auto& texts) {
+		std::vector<std::string_view> words;
+		size_t word_count = 0;
+		for (const auto& text : texts) {
+			SplitIntoValidWords(text, words);
+			word_count += words.size();
+		}
+		return static_cast<double>(word_count);
+	};
+	std::vector<std::string_view> document_texts;
+	for (const RawDocument& document : documents) {
+		document_texts.push_back(document.text);
+	}
+	runner.Measure("split/words_1", one_word_queries.size(), [&] {
+		return split(one_word_queries);
+		});
+	runner.Measure("split/words_3", three_word_queries.size(), [&] {
+		return split(three_word_queries);
+		});
+	runner.Measure("split/documents", document_texts.size(), [&] {
+		return split(document_texts);
+		});
+
+	std::unique_ptr<SearchServer> server;
+	const auto make_server = [&] {
+		server.reset();
+		server = std::make_unique<SearchServer>(stop_words);
+	};
+	const auto make_loaded_server = [&](const std::vector<RawDocument>& batch) {
+		return [&] {
+			make_server();
+			server->AddDocuments(std::execution::par, batch);
+		};
+	};
+
+	runner.Measure("ingest/add_document", documents.size(), make_server, [&] {
+		for (const RawDocument& document : documents) {
+			server->AddDocument(document.id, document.text, document.status, document.ratings);
+		}
+		return static_cast<double>(server->GetDocumentCount());
+		});
+	runner.Measure("ingest/add_documents_seq", documents.size(), make_server, [&] {
+		server->AddDocuments(std::execution::seq, documents);
+		return static_cast<double>(server->GetDocumentCount());
+		});
+	runner.Measure("ingest/add_documents_par", documents.size(), make_server, [&] {
+		server->AddDocuments(std::execution::par, documents);
+		return static_cast<double>(server->GetDocumentCount());
+		});
+
+	make_loaded_server(documents)();
+	SearchServer& search_server = *server;
+	const auto find = [&search_server](const std::string& query) {
+		return search_server.FindTopDocuments(query);
+	};
+	const auto find_par = [&search_server](const std::string& query) {
+		return search_server.FindTopDocuments(std::execution::par, query);
+	};
+	for (const auto& [name, queries] : {
+		std::pair{ "query/words_1", &one_word_queries },
+		std::pair{ "query/words_3", &three_word_queries },
+		std::pair{ "query/words_10", &ten_word_queries },
+		std::pair{ "query/words_70", &long_queries },
+		std::pair{ "query/minus_25", &minus_queries },
+		std::pair{ "query/zipf_3", &std::as_const(zipf_queries) } }) {
+		runner.Measure(name, queries->size(), [&, queries = queries] {
+			return RunQueries(*queries, find);
+			});
+	}
+	search_server.SetQueryEvaluation(QueryEvaluation::MAX_SCORE);
+	runner.Measure("query/words_3_max_score", three_word_queries.size(), [&] {
+		return RunQueries(three_word_queries, find);
+		});
+	runner.Measure("query/words_70_max_score", long_queries.size(), [&] {
+		return RunQueries(long_queries, find);
+		});
+	runner.Measure("query/zipf_3_max_score", zipf_queries.size(), [&] {
+		return RunQueries(zipf_queries, find);
+		});
+	search_server.SetQueryEvaluation(QueryEvaluation::EXHAUSTIVE);
+	runner.Measure("query/words_70_par", long_queries.size(), [&] {
+		return RunQueries(long_queries, find_par);
+		});
+#ifdef HAS_TBB_GLOBAL_CONTROL
+	const size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+	for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+		tbb::global_control control(tbb::global_control::max_allowed_parallelism, threads);
+		runner.Measure("query/words_70_par_threads_" + std::to_string(threads), long_queries.size(), [&] {
+			return RunQueries(long_queries, find_par);
+			});
+	}
+#endif
+#ifdef SEARCH_SERVER_METRICS
+	// Where the time of a three-word query goes, for either evaluation.
+	for (const auto& [name, query_evaluation] : {
+		std::pair{ "query/stages_exhaustive", QueryEvaluation::EXHAUSTIVE },
+		std::pair{ "query/stages_max_score", QueryEvaluation::MAX_SCORE } }) {
+		if (runner.IsSelected(name)) {
+			search_server.SetQueryEvaluation(query_evaluation);
+			ResetQueryMetrics();
+			RunQueries(three_word_queries, find);
+			std::cerr << name << std::endl << GetQueryMetrics();
+		}
+	}
+	search_server.SetQueryEvaluation(QueryEvaluation::EXHAUSTIVE);
+#endif
+#ifdef SEARCH_SERVER_COUNT_ALLOCATIONS
+	// Allocations per query once a first pass has grown the per-thread scratch.
+	const std::vector<std::string> unknown_word_queries = { "zzzzzzzzzzzz", "-zzzzzzzzzzzz yyyyyyyyyyyy", stop_words + " xxxxxxxxxxxx" };
+	for (const auto& [name, queries] : {
+		std::pair{ "query/allocations_unknown_words", &unknown_word_queries },
+		std::pair{ "query/allocations_words_3", &three_word_queries } }) {
+		if (runner.IsSelected(name)) {
+			RunQueries(*queries, find);
+			const size_t allocations_before = GetAllocationStats().count;
+			RunQueries(*queries, find);
+			std::cerr << name << ": " << static_cast<double>(GetAllocationStats().count - allocations_before) / queries->size() << " per query" << std::endl;
+		}
+	}
+#endif
+
+	runner.Measure("query_cache/uncached", repeated_queries.size(), [&] {
+		return RunQueries(repeated_queries, find);
+		});
+	std::unique_ptr<QueryCache> cache;
+	runner.Measure("query_cache/cached", repeated_queries.size(), [&] {
+		cache.reset();
+		cache = std::make_unique<QueryCache>(search_server, QUERY_CACHE_CAPACITY);
+		}, [&] {
+		return RunQueries(repeated_queries, [&cache](const std::string& query) {
+			return cache->FindTopDocuments(query);
+			});
+		});
+	cache.reset();
+
+	const std::string snapshot_path = (std::filesystem::temp_directory_path() / ("search_server_" + std::to_string(getpid()) + ".snapshot")).string();
+	for (const auto& [name, posting_format] : { std::pair{ "raw", PostingFormat::RAW }, std::pair{ "compressed", PostingFormat::COMPRESSED } }) {
+		runner.Measure("snapshot/save_" + std::string(name), documents.size(), [&, posting_format = posting_format] {
+			search_server.SaveSnapshot(snapshot_path, posting_format);
+			return static_cast<double>(std::filesystem::file_size(snapshot_path));
+			});
+		// Opening validates the whole index.
+		const std::string open_name = "snapshot/open_" + std::string(name);
+		if (runner.IsSelected(open_name)) {
+			search_server.SaveSnapshot(snapshot_path, posting_format);
+			runner.Measure(open_name, 1, [&] {
+				const IndexSnapshot snapshot(snapshot_path);
+				return static_cast<double>(snapshot.GetPostingCount());
+				});
+		}
+		const std::string query_name = "snapshot/words_3_" + std::string(name);
+		if (runner.IsSelected(query_name)) {
+			search_server.SaveSnapshot(snapshot_path, posting_format);
+			const IndexSnapshot snapshot(snapshot_path);
+			runner.Measure(query_name, three_word_queries.size(), [&] {
+				return RunQueries(three_word_queries, [&snapshot](const std::string& query) {
+					return snapshot.FindTopDocuments(query);
+					});
+				});
+		}
+	}
+	std::filesystem::remove(snapshot_path);
+
+	// Adds every document and removes every REMOVAL_PERIOD-th one right after the next is added.
+	const auto update = [&](auto& updated_server) {
+		for (size_t i = 0; i < documents.size(); ++i) {
+			const RawDocument& document = documents[i];
+			updated_server.AddDocument(document.id, document.text, document.status, document.ratings);
+			if (i % REMOVAL_PERIOD == 1) {
+				updated_server.RemoveDocument(documents[i - 1].id);
+			}
+		}
+		return static_cast<double>(updated_server.GetDocumentCount());
+	};
+	const size_t update_count = documents.size() + documents.size() / REMOVAL_PERIOD;
+	std::unique_ptr<SearchServer> updated_server;
+	runner.Measure("update/search_server", update_count, [&] {
+		updated_server.reset();
+		updated_server = std::make_unique<SearchServer>(stop_words);
+		}, [&] {
+		return update(*updated_server);
+		});
+	updated_server.reset();
+	std::unique_ptr<SegmentedSearchServer> segmented_server;
+	const auto make_segmented_server = [&] {
+		segmented_server.reset();
+		segmented_server = std::make_unique<SegmentedSearchServer>(stop_words);
+	};
+	runner.Measure("update/segmented", update_count, make_segmented_server, [&] {
+		return update(*segmented_server);
+		});
+	if (runner.IsSelected("query/segmented_words_3")) {
+		make_segmented_server();
+		update(*segmented_server);
+		segmented_server->WaitForMerges();
+		runner.Measure("query/segmented_words_3", three_word_queries.size(), [&] {
+			return RunQueries(three_word_queries, [&segmented_server](const std::string& query) {
+				return segmented_server->FindTopDocuments(query);
+				});
+			});
+	}
+	segmented_server.reset();
+
+	// Readers query the published generation while a writer replaces the older
+	// half of the corpus; their latencies over all rounds go to std::cerr.
+	std::unique_ptr<ConcurrentSearchServer> concurrent_server;
+	const size_t initial_count = documents.size() / 2;
+	std::vector<std::vector<double>> read_latencies;
+	runner.Measure("concurrent/ingest_under_reads", documents.size() - initial_count, [&] {
+		concurrent_server.reset();
+		concurrent_server = std::make_unique<ConcurrentSearchServer>(stop_words);
+		for (size_t i = 0; i < initial_count; ++i) {
+			concurrent_server->AddDocument(documents[i].id, documents[i].text, documents[i].status, documents[i].ratings);
+		}
+		concurrent_server->Publish();
+		}, [&] {
+		std::atomic<bool> writing = true;
+		std::vector<std::thread> readers;
+		const size_t reader_count = std::max(2u, std::thread::hardware_concurrency());
+		read_latencies.resize(reader_count);
+		for (size_t reader = 0; reader < reader_count; ++reader) {
+			readers.emplace_back([&, reader] {
+				for (size_t round = reader; writing; ++round) {
+					const auto start_time = std::chrono::steady_clock::now();
+					concurrent_server->FindTopDocuments(three_word_queries[round % three_word_queries.size()]);
+					read_latencies[reader].push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+				}
+				});
+		}
+		for (size_t i = initial_count; i < documents.size(); ++i) {
+			concurrent_server->AddDocument(documents[i].id, documents[i].text, documents[i].status, documents[i].ratings);
+			concurrent_server->RemoveDocument(documents[i - initial_count].id);
+			if ((i + 1) % PUBLISH_INTERVAL == 0) {
+				concurrent_server->Publish();
+			}
+		}
+		concurrent_server->Publish();
+		writing = false;
+		for (std::thread& reader : readers) {
+			reader.join();
+		}
+		return static_cast<double>(concurrent_server->GetDocumentCount());
+		});
+	concurrent_server.reset();
+	if (runner.IsSelected("concurrent/ingest_under_reads")) {
+		std::vector<double> all_read_latencies;
+		for (const std::vector<double>& latencies : read_latencies) {
+			all_read_latencies.insert(all_read_latencies.end(), latencies.begin(), latencies.end());
+		}
+		std::cerr << "concurrent/ingest_under_reads: " << all_read_latencies.size() << " reads, " << DescribeLatencies(std::move(all_read_latencies)) << std::endl;
+	}
+
+	for (size_t shard_count = 1; shard_count <= MAX_BENCHMARK_SHARDS; shard_count *= 2) {
+		const std::string name = "sharded/shards_" + std::to_string(shard_count) + "/words_3";
+		if (runner.IsSelected(name)) {
+			ShardedSearchServer sharded_server(stop_words, shard_count);
+			for (const RawDocument& document : documents) {
+				sharded_server.AddDocument(document.id, document.text, document.status, document.ratings);
+			}
+			runner.Measure(name, three_word_queries.size(), [&] {
+				return RunQueries(three_word_queries, [&sharded_server](const std::string& query) {
+					return sharded_server.FindTopDocuments(query);
+					});
+				});
+		}
+	}
+	// The same over shard processes of this program, queried through a ShardRouter.
+	for (size_t shard_count = 1; shard_count <= MAX_BENCHMARK_SHARDS; shard_count *= 2) {
+		const std::string name = "shard_processes/shards_" + std::to_string(shard_count) + "/words_3";
+		if (!runner.IsSelected(name)) {
+			continue;
+		}
+		std::vector<pid_t> processes;
+		{
+			ShardRouter router(StartShardProcesses(stop_words, shard_count, processes), BENCHMARK_SHARD_TIMEOUT);
+			for (const RawDocument& document : documents) {
+				router.AddDocument(document.id, document.text, document.status, document.ratings);
+			}
+			runner.Measure(name, three_word_queries.size(), [&] {
+				return RunQueries(three_word_queries, [&router](const std::string& query) {
+					return router.FindTopDocuments(query);
+					});
+				});
+			router.Shutdown();
+		}
+		for (const pid_t process : processes) {
+			waitpid(process, nullptr, 0);
+		}
+	}
+
+	const auto match = [&](auto policy) {
+		size_t word_count = 0;
+		for (size_t i = 0; i < ten_word_queries.size(); ++i) {
+			const auto [words, status] = search_server.MatchDocument(policy, ten_word_queries[i], documents[i % documents.size()].id);
+			word_count += words.size();
+		}
+		return static_cast<double>(word_count);
+	};
+	runner.Measure("match_document/seq", ten_word_queries.size(), [&] {
+		return match(std::execution::seq);
+		});
+	runner.Measure("match_document/par", ten_word_queries.size(), [&] {
+		return match(std::execution::par);
+		});
+
+	// A results page: every query matched against the same PAGE_SIZE documents.
+	std::vector<int> page_ids;
+	for (size_t i = 0; i < std::min(PAGE_SIZE, documents.size()); ++i) {
+		page_ids.push_back(documents[i * (documents.size() / std::min(PAGE_SIZE, documents.size()))].id);
+	}
+	runner.Measure("match_documents/page_loop", ten_word_queries.size() * page_ids.size(), [&] {
+		size_t word_count = 0;
+		for (const std::string& query : ten_word_queries) {
+			for (const int document_id : page_ids) {
+				word_count += std::get<0>(search_server.MatchDocument(query, document_id)).size();
+			}
+		}
+		return static_cast<double>(word_count);
+		});
+	runner.Measure("match_documents/page_batch", ten_word_queries.size() * page_ids.size(), [&] {
+		size_t word_count = 0;
+		for (const std::string& query : ten_word_queries) {
+			for (const auto& [words, status] : search_server.MatchDocuments(query, page_ids)) {
+				word_count += words.size();
+			}
+		}
+		return static_cast<double>(word_count);
+		});
+	std::vector<int> all_ids;
+	for (const RawDocument& document : documents) {
+		all_ids.push_back(document.id);
+	}
+	const size_t full_match_query_count = std::max<size_t>(1, options.query_count / FULL_MATCH_QUERY_DIVISOR);
+	const auto match_all = [&](auto policy) {
+		size_t word_count = 0;
+		for (size_t i = 0; i < full_match_query_count; ++i) {
+			for (const auto& [words, status] : search_server.MatchDocuments(policy, ten_word_queries[i], all_ids)) {
+				word_count += words.size();
+			}
+		}
+		return static_cast<double>(word_count);
+	};
+	runner.Measure("match_documents/all_seq", full_match_query_count * all_ids.size(), [&] {
+		return match_all(std::execution::seq);
+		});
+	runner.Measure("match_documents/all_par", full_match_query_count * all_ids.size(), [&] {
+		return match_all(std::execution::par);
+		});
+
+	runner.Measure("process_queries", three_word_queries.size(), [&] {
+		double total_relevance = 0;
+		for (const std::vector<Document>& query_documents : ProcessQueries(search_server, three_word_queries)) {
+			total_relevance += SumRelevance(query_documents);
+		}
+		return total_relevance;
+		});
+	runner.Measure("process_queries_joined", three_word_queries.size(), [&] {
+		return SumRelevance(ProcessQueriesJoined(search_server, three_word_queries));
+		});
+	runner.Measure("process_queries_flat", three_word_queries.size(), [&] {
+		return SumRelevance(ProcessQueriesFlat(GetDefaultQueryExecutor(), search_server, three_word_queries).documents);
+		});
+	runner.Measure("process_queries_streaming", three_word_queries.size(), [&] {
+		double total_relevance = 0;
+		ProcessQueriesJoined(GetDefaultQueryExecutor(), search_server, three_word_queries, [&total_relevance](size_t, const std::vector<Document>& query_documents) {
+			total_relevance += SumRelevance(query_documents);
+			});
+		return total_relevance;
+		});
+	runner.Measure("process_queries_skewed/executor", skewed_queries.size(), [&] {
+		double total_relevance = 0;
+		for (const std::vector<Document>& query_documents : ProcessQueries(search_server, skewed_queries)) {
+			total_relevance += SumRelevance(query_documents);
+		}
+		return total_relevance;
+		});
+	// Heavy queries split into a nested batch, as ProcessQueries does, on a fixed
+	// pool so the nesting happens on any machine; their latencies go to std::cerr.
+	if (runner.IsSelected("executor/nested_batches")) {
+		QueryExecutor executor(NESTED_BENCHMARK_THREADS);
+		const size_t partition_count = executor.GetThreadCount() * PARTITIONS_PER_THREAD;
+		std::vector<double> latencies(skewed_queries.size());
+		runner.Measure("executor/nested_batches", skewed_queries.size(), [&] {
+			std::vector<double> relevance(skewed_queries.size());
+			executor.ParallelFor(skewed_queries.size(), [&](size_t i) {
+				const auto start_time = std::chrono::steady_clock::now();
+				if (i % HEAVY_QUERY_PERIOD == 0) {
+					std::vector<double> partition_relevance(partition_count);
+					executor.ParallelFor(partition_count, [&](size_t partition) {
+						partition_relevance[partition] = SumRelevance(search_server.FindTopDocumentsInPartition(skewed_queries[i], partition, partition_count));
+						});
+					relevance[i] = std::accumulate(partition_relevance.begin(), partition_relevance.end(), 0.0);
+				}
+				else {
+					relevance[i] = SumRelevance(search_server.FindTopDocuments(skewed_queries[i]));
+				}
+				latencies[i] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+				});
+			return std::accumulate(relevance.begin(), relevance.end(), 0.0);
+			});
+		std::vector<double> heavy_latencies;
+		for (size_t i = 0; i < latencies.size(); i += HEAVY_QUERY_PERIOD) {
+			heavy_latencies.push_back(latencies[i]);
+		}
+		std::cerr << "executor/nested_batches: heavy queries " << DescribeLatencies(std::move(heavy_latencies)) << ", all queries " << DescribeLatencies(latencies) << std::endl;
+	}
+	runner.Measure("process_queries_skewed/transform_par", skewed_queries.size(), [&] {
+		std::vector<double> relevance(skewed_queries.size());
+		std::transform(std::execution::par, skewed_queries.begin(), skewed_queries.end(), relevance.begin(), [&search_server](const std::string& query) {
+			return SumRelevance(search_server.FindTopDocuments(query));
+			});
+		return std::accumulate(relevance.begin(), relevance.end(), 0.0);
+		});
+
+	runner.Measure("remove/remove_document", removed_ids.size(), make_loaded_server(documents), [&] {
+		for (const int document_id : removed_ids) {
+			server->RemoveDocument(document_id);
+		}
+		return static_cast<double>(server->GetDocumentCount());
+		});
+	runner.Measure("remove/remove_documents_seq", removed_ids.size(), make_loaded_server(documents), [&] {
+		server->RemoveDocuments(std::execution::seq, removed_ids);
+		return static_cast<double>(server->GetDocumentCount());
+		});
+	runner.Measure("remove/remove_documents_par", removed_ids.size(), make_loaded_server(documents), [&] {
+		server->RemoveDocuments(std::execution::par, removed_ids);
+		return static_cast<double>(server->GetDocumentCount());
+		});
+	runner.Measure("remove/remove_duplicates", duplicate_documents.size(), make_loaded_server(duplicate_documents), [&] {
+		return static_cast<double>(RemoveDuplicates(*server).size());
+		});
+	if (runner.IsSelected("duplicates/find") || runner.IsSelected("duplicates/find_near")) {
+		make_loaded_server(duplicate_documents)();
+		runner.Measure("duplicates/find", duplicate_documents.size(), [&] {
+			return static_cast<double>(FindDuplicates(*server).size());
+			});
+		runner.Measure("duplicates/find_near", duplicate_documents.size(), [&] {
+			return static_cast<double>(FindNearDuplicates(*server, NEAR_DUPLICATE_SIMILARITY).size());
+			});
+	}
+	server.reset();
+
+	std::vector<BenchmarkResult>& results = runner.GetResults();
+	if (options.format == BenchmarkFormat::JSON) {
+		PrintJson(options, results, output);
+	}
+	else if (options.format == BenchmarkFormat::CSV) {
+		PrintCsv(results, output);
+	}
+	else {
+		PrintText(results, output);
+	}
+	return results;
+}
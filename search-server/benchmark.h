@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class BenchmarkFormat {
+	TEXT,
+	JSON,
+	CSV,
+};
+
+struct BenchmarkOptions {
+	size_t document_count = 10'000;
+	int dictionary_size = 1000;
+	int document_word_count = 70;
+	size_t query_count = 1000;
+	// Exponent of the Zipf law for document words; 0 draws them uniformly.
+	double corpus_zipf_exponent = 0;
+	int warmup = 1;
+	int repetitions = 5;
+	uint32_t seed = 5489;
+	// Runs only benchmarks whose name contains this.
+	std::string filter;
+	BenchmarkFormat format = BenchmarkFormat::TEXT;
+};
+
+// Parses "--documents N", "--format json" and the like; throws std::invalid_argument.
+BenchmarkOptions ParseBenchmarkOptions(const std::vector<std::string_view>& arguments);
+
+std::string GetBenchmarkUsage();
+
+struct BenchmarkResult {
+	std::string name;
+	// Documents or queries handled by one repetition.
+	size_t item_count = 0;
+	std::vector<double> seconds;
+	// Peak resident set size while the benchmark ran, setup included.
+	size_t peak_memory = 0;
+	// Sum derived from the results, to spot changes in what the code returns.
+	double checksum = 0;
+
+	double GetMin() const;
+
+	double GetMax() const;
+
+	double GetMedian() const;
+
+	double GetMean() const;
+
+	double GetStandardDeviation() const;
+
+	double GetItemsPerSecond() const;
+};
+
+// Builds the corpus from options, then runs every benchmark matching the
+// filter with untimed warmup rounds and timed repetitions. Only the timed
+// part of each repetition is measured; fresh servers for removals are built
+// outside it. Results go to output in the chosen format. Builds with
+// -DSEARCH_SERVER_METRICS or -DSEARCH_SERVER_COUNT_ALLOCATIONS also print query
+// stage timings or allocations per query to std::cerr. The concurrent ingest
+// benchmark also prints reader latency percentiles there.
+std::vector<BenchmarkResult> RunBenchmarks(const BenchmarkOptions& options, std::ostream& output);
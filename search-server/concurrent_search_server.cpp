@@ -0,0 +1,146 @@
+#include "concurrent_search_server.h"
+
+#include <algorithm>
+#include <utility>
+
+ConcurrentSearchServer::Generation::Generation(std::shared_ptr<const SearchServer> base, std::unique_ptr<const SearchServer> delta, std::unordered_set<int> removed_ids, const CorpusStats& corpus_stats)
+	: base_(std::move(base))
+	, delta_(std::move(delta))
+	, removed_ids_(std::move(removed_ids))
+	, corpus_stats_(corpus_stats)
+{
+}
+
+std::vector<Document> ConcurrentSearchServer::Generation::FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t top_count) const {
+	return FindTopDocuments(raw_query, DocumentStatusFilter{ status }, top_count);
+}
+
+std::vector<Document> ConcurrentSearchServer::Generation::FindTopDocuments(std::string_view raw_query) const {
+	return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ConcurrentSearchServer::Generation::MatchDocument(std::string_view raw_query, int document_id) const {
+	if (delta_->HasDocument(document_id)) {
+		return delta_->MatchDocument(raw_query, document_id);
+	}
+	if (removed_ids_.count(document_id) == 1) {
+		throw std::out_of_range("Нет ID");
+	}
+	return base_->MatchDocument(raw_query, document_id);
+}
+
+int ConcurrentSearchServer::Generation::GetDocumentCount() const {
+	return base_->GetDocumentCount() - static_cast<int>(removed_ids_.size()) + delta_->GetDocumentCount();
+}
+
+std::shared_ptr<const ConcurrentSearchServer::Generation> ConcurrentSearchServer::GetGeneration() const {
+	return std::atomic_load(&published_);
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const {
+	return GetGeneration()->GetDocumentCount();
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+	std::lock_guard guard(write_mutex_);
+	if (base_->HasDocument(document_id) && removed_ids_.count(document_id) == 0) {
+		throw std::invalid_argument("Идентификатор используется");
+	}
+	delta_->AddDocument(document_id, document, status, ratings);
+	delta_documents_[document_id] = { std::string(document), status, ratings, ++write_count_ };
+	corpus_stats_.AddDocument(delta_->GetWordFrequencies(document_id));
+	++pending_write_count_;
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+	std::lock_guard guard(write_mutex_);
+	if (delta_->HasDocument(document_id)) {
+		corpus_stats_.RemoveDocument(delta_->GetWordFrequencies(document_id));
+		delta_->RemoveDocument(document_id);
+		delta_documents_.erase(document_id);
+	}
+	else if (base_->HasDocument(document_id) && removed_ids_.count(document_id) == 0) {
+		corpus_stats_.RemoveDocument(base_->GetWordFrequencies(document_id));
+		removed_ids_.insert(document_id);
+	}
+	else {
+		throw std::invalid_argument("Документа нет");
+	}
+	++write_count_;
+	++pending_write_count_;
+}
+
+void ConcurrentSearchServer::Publish() {
+	std::unique_lock lock(write_mutex_);
+	if (pending_write_count_ == 0) {
+		return;
+	}
+	if (!is_folding_ && NeedsFold()) {
+		Fold(lock);
+	}
+	// Only the delta and the stats are copied; readers keep using the old generation.
+	const std::shared_ptr<const Generation> generation(new Generation(base_, std::make_unique<SearchServer>(*delta_), removed_ids_, corpus_stats_));
+	std::atomic_store(&published_, generation);
+	pending_write_count_ = 0;
+}
+
+size_t ConcurrentSearchServer::GetPendingWriteCount() const {
+	std::lock_guard guard(write_mutex_);
+	return pending_write_count_;
+}
+
+size_t ConcurrentSearchServer::GetFoldCount() const {
+	std::lock_guard guard(write_mutex_);
+	return fold_count_;
+}
+
+bool ConcurrentSearchServer::NeedsFold() const {
+	const size_t change_count = delta_documents_.size() + removed_ids_.size();
+	return change_count >= std::max(MIN_DELTA_CHANGES_TO_FOLD, static_cast<size_t>(base_->GetDocumentCount()) / DELTA_FOLD_FRACTION);
+}
+
+void ConcurrentSearchServer::Fold(std::unique_lock<std::mutex>& lock) {
+	is_folding_ = true;
+	const std::shared_ptr<const SearchServer> base = base_;
+	const std::unordered_set<int> removed_ids = removed_ids_;
+	const std::map<int, DeltaDocument> delta_documents = delta_documents_;
+	lock.unlock();
+
+	auto next_base = std::make_shared<SearchServer>(*base);
+	next_base->RemoveDocuments(std::vector<int>(removed_ids.begin(), removed_ids.end()));
+	for (const auto& [document_id, document] : delta_documents) {
+		next_base->AddDocument(document_id, document.text, document.status, document.ratings);
+	}
+
+	lock.lock();
+	// The live documents are the same as before the fold, so the stats stay.
+	// Base removals made meanwhile carry over; delta documents folded into the
+	// new base and removed or replaced meanwhile become base removals.
+	std::unordered_set<int> next_removed_ids;
+	for (const int document_id : removed_ids_) {
+		if (removed_ids.count(document_id) == 0) {
+			next_removed_ids.insert(document_id);
+		}
+	}
+	for (const auto& [document_id, document] : delta_documents) {
+		const auto it = delta_documents_.find(document_id);
+		if (it == delta_documents_.end() || it->second.write_number != document.write_number) {
+			next_removed_ids.insert(document_id);
+		}
+	}
+	std::map<int, DeltaDocument> next_delta_documents;
+	auto next_delta = std::make_unique<SearchServer>(empty_server_);
+	for (auto& [document_id, document] : delta_documents_) {
+		const auto it = delta_documents.find(document_id);
+		if (it == delta_documents.end() || it->second.write_number != document.write_number) {
+			next_delta->AddDocument(document_id, document.text, document.status, document.ratings);
+			next_delta_documents.emplace(document_id, std::move(document));
+		}
+	}
+	base_ = std::move(next_base);
+	delta_ = std::move(next_delta);
+	delta_documents_ = std::move(next_delta_documents);
+	removed_ids_ = std::move(next_removed_ids);
+	is_folding_ = false;
+	++fold_count_;
+}
@@ -0,0 +1,144 @@
+#pragma once
+#include "corpus_stats.h"
+#include "search_server.h"
+#include "top_documents.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Publish folds the delta into a new base once it holds this many changes, or
+// one DELTA_FOLD_FRACTION-th of the base if that is more.
+const size_t MIN_DELTA_CHANGES_TO_FOLD = 1024;
+const size_t DELTA_FOLD_FRACTION = 8;
+
+// Readers query the published generation while writers update private state.
+// A generation is an immutable base SearchServer shared by many generations, a
+// small delta SearchServer with the documents added since the base was built,
+// the base ids removed since, and document frequencies of the whole corpus, so
+// relevance matches a single SearchServer. Publish copies the delta, the
+// removed ids and the frequencies, never the base. Once the delta grows past
+// the fold threshold, the Publish call that notices rebuilds the base outside
+// the write lock; other writers and publishers carry on meanwhile. A retired
+// generation is freed when its last reader lets go, so Publish never waits for readers.
+class ConcurrentSearchServer {
+public:
+	class Generation {
+	public:
+		template <typename DocumentPredicate>
+		std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+		std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+		std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+		std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+		int GetDocumentCount() const;
+
+	private:
+		friend class ConcurrentSearchServer;
+
+		const std::shared_ptr<const SearchServer> base_;
+		const std::unique_ptr<const SearchServer> delta_;
+		const std::unordered_set<int> removed_ids_;
+		const CorpusStats corpus_stats_;
+
+		Generation(std::shared_ptr<const SearchServer> base, std::unique_ptr<const SearchServer> delta, std::unordered_set<int> removed_ids, const CorpusStats& corpus_stats);
+	};
+
+	template <typename StopWords>
+	explicit ConcurrentSearchServer(const StopWords& stop_words);
+
+	// Results that point into the index (MatchDocument words) stay valid for as
+	// long as the returned generation is held.
+	std::shared_ptr<const Generation> GetGeneration() const;
+
+	template <typename... Args>
+	std::vector<Document> FindTopDocuments(Args&&... args) const {
+		return GetGeneration()->FindTopDocuments(std::forward<Args>(args)...);
+	}
+
+	int GetDocumentCount() const;
+
+	// Writes are validated and applied immediately, but readers see them only
+	// after Publish.
+	void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+	void RemoveDocument(int document_id);
+
+	void Publish();
+
+	size_t GetPendingWriteCount() const;
+
+	// Base rebuilds so far.
+	size_t GetFoldCount() const;
+
+private:
+	// Delta documents are kept as text to be added to the next base. The write
+	// number tells a document re-added during a fold from the one being folded.
+	struct DeltaDocument {
+		std::string text;
+		DocumentStatus status;
+		std::vector<int> ratings;
+		uint64_t write_number;
+	};
+
+	// Copied to start every new delta and base.
+	const SearchServer empty_server_;
+	// Accessed with std::atomic_load/atomic_store; only Publish replaces it.
+	std::shared_ptr<const Generation> published_;
+
+	mutable std::mutex write_mutex_;
+	std::shared_ptr<const SearchServer> base_;
+	std::unique_ptr<SearchServer> delta_;
+	std::map<int, DeltaDocument> delta_documents_;
+	std::unordered_set<int> removed_ids_;
+	CorpusStats corpus_stats_;
+	uint64_t write_count_ = 0;
+	size_t pending_write_count_ = 0;
+	bool is_folding_ = false;
+	size_t fold_count_ = 0;
+
+	bool NeedsFold() const;
+
+	// Builds a base from the current one and the delta without holding the
+	// lock, then keeps only the writes made meanwhile in the delta.
+	void Fold(std::unique_lock<std::mutex>& lock);
+};
+
+template <typename StopWords>
+ConcurrentSearchServer::ConcurrentSearchServer(const StopWords& stop_words)
+	: empty_server_(stop_words)
+	, base_(std::make_shared<SearchServer>(empty_server_))
+	, delta_(std::make_unique<SearchServer>(empty_server_))
+{
+	published_.reset(new Generation(base_, std::make_unique<SearchServer>(empty_server_), {}, corpus_stats_));
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> ConcurrentSearchServer::Generation::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t top_count) const {
+	TopDocuments top_documents(top_count);
+	const auto add_documents = [&top_documents](const std::vector<Document>& documents) {
+		for (const Document& document : documents) {
+			top_documents.Add(document);
+		}
+	};
+	if (removed_ids_.empty()) {
+		add_documents(base_->FindTopDocuments(raw_query, document_predicate, top_count, corpus_stats_));
+	}
+	else {
+		add_documents(base_->FindTopDocuments(raw_query, [this, &document_predicate](int document_id, DocumentStatus status, int rating) {
+			return removed_ids_.count(document_id) == 0 && document_predicate(document_id, status, rating);
+			}, top_count, corpus_stats_));
+	}
+	add_documents(delta_->FindTopDocuments(raw_query, document_predicate, top_count, corpus_stats_));
+	return top_documents.Extract();
+}
@@ -0,0 +1,63 @@
+#include "corpus_generator.h"
+
+#include <algorithm>
+#include <cmath>
+
+std::string GenerateWord(std::mt19937& generator, int max_length) {
+	const int length = std::uniform_int_distribution(1, max_length)(generator);
+	std::string word;
+	word.reserve(length);
+	for (int i = 0; i < length; ++i) {
+		word.push_back(std::uniform_int_distribution((int)'a', (int)'z')(generator));
+	}
+	return word;
+}
+
+std::vector<std::string> GenerateDictionary(std::mt19937& generator, int word_count, int max_length) {
+	std::vector<std::string> words;
+	words.reserve(word_count);
+	for (int i = 0; i < word_count; ++i) {
+		words.push_back(GenerateWord(generator, max_length));
+	}
+	words.erase(std::unique(words.begin(), words.end()), words.end());
+	return words;
+}
+
+ZipfDistribution::ZipfDistribution(size_t size, double exponent)
+	: cumulative_weights_(size)
+{
+	double total_weight = 0;
+	for (size_t i = 0; i < size; ++i) {
+		total_weight += 1.0 / std::pow(i + 1, exponent);
+		cumulative_weights_[i] = total_weight;
+	}
+}
+
+size_t ZipfDistribution::operator()(std::mt19937& generator) const {
+	const double weight = std::uniform_real_distribution<>(0, cumulative_weights_.back())(generator);
+	const auto it = std::upper_bound(cumulative_weights_.begin(), cumulative_weights_.end(), weight);
+	return std::min<size_t>(it - cumulative_weights_.begin(), cumulative_weights_.size() - 1);
+}
+
+std::string GenerateQuery(std::mt19937& generator, const std::vector<std::string>& dictionary, int word_count, double minus_prob, const ZipfDistribution* distribution) {
+	std::string query;
+	for (int i = 0; i < word_count; ++i) {
+		if (!query.empty()) {
+			query.push_back(' ');
+		}
+		if (std::uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+			query.push_back('-');
+		}
+		query += dictionary[distribution != nullptr ? (*distribution)(generator) : std::uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+	}
+	return query;
+}
+
+std::vector<std::string> GenerateQueries(std::mt19937& generator, const std::vector<std::string>& dictionary, int query_count, int max_word_count) {
+	std::vector<std::string> queries;
+	queries.reserve(query_count);
+	for (int i = 0; i < query_count; ++i) {
+		queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
+	}
+	return queries;
+}
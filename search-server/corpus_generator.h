@@ -0,0 +1,26 @@
+#pragma once
+#include <random>
+#include <string>
+#include <vector>
+
+// Random corpora and queries for the demo in main.cpp and the --bench suite.
+
+std::string GenerateWord(std::mt19937& generator, int max_length);
+
+std::vector<std::string> GenerateDictionary(std::mt19937& generator, int word_count, int max_length);
+
+// Index i drawn with probability proportional to 1 / (i + 1)^exponent.
+class ZipfDistribution {
+public:
+	ZipfDistribution(size_t size, double exponent);
+
+	size_t operator()(std::mt19937& generator) const;
+
+private:
+	std::vector<double> cumulative_weights_;
+};
+
+// Words drawn uniformly from the dictionary, or by Zipf rank when distribution is given.
+std::string GenerateQuery(std::mt19937& generator, const std::vector<std::string>& dictionary, int word_count, double minus_prob = 0, const ZipfDistribution* distribution = nullptr);
+
+std::vector<std::string> GenerateQueries(std::mt19937& generator, const std::vector<std::string>& dictionary, int query_count, int max_word_count);
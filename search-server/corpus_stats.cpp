@@ -0,0 +1,86 @@
+#include "corpus_stats.h"
+
+void CorpusStats::AddDocument(const std::map<std::string_view, double>& word_freqs) {
+	for (const auto& [word, term_freq] : word_freqs) {
+		++document_freqs_[AddWord(word)];
+	}
+	++document_count_;
+	++version_;
+}
+
+void CorpusStats::AddDocument(const std::vector<std::string_view>& words) {
+	for (std::string_view word : words) {
+		++document_freqs_[AddWord(word)];
+	}
+	++document_count_;
+	++version_;
+}
+
+void CorpusStats::RemoveDocument(const std::map<std::string_view, double>& word_freqs) {
+	for (const auto& [word, term_freq] : word_freqs) {
+		RemoveWord(word);
+	}
+	--document_count_;
+	++version_;
+	if (dictionary_.NeedsCompaction()) {
+		dictionary_.Compact();
+	}
+}
+
+void CorpusStats::RemoveDocument(const std::vector<std::string_view>& words) {
+	for (std::string_view word : words) {
+		RemoveWord(word);
+	}
+	--document_count_;
+	++version_;
+	if (dictionary_.NeedsCompaction()) {
+		dictionary_.Compact();
+	}
+}
+
+void CorpusStats::SetDocumentCount(int document_count) {
+	document_count_ = document_count;
+	++version_;
+}
+
+void CorpusStats::SetDocumentFreq(std::string_view word, int document_freq) {
+	document_freqs_[AddWord(word)] = document_freq;
+	++version_;
+}
+
+int CorpusStats::GetDocumentCount() const {
+	return document_count_;
+}
+
+int CorpusStats::GetDocumentFreq(std::string_view word) const {
+	const int term_id = dictionary_.GetTermId(word);
+	return term_id == TermDictionary::NO_TERM ? 0 : document_freqs_[term_id];
+}
+
+std::optional<double> CorpusStats::FindInverseDocumentFreq(std::string_view word) const {
+	const int term_id = dictionary_.GetTermId(word);
+	if (term_id == TermDictionary::NO_TERM || document_freqs_[term_id] <= 0 || document_count_ <= 0) {
+		return std::nullopt;
+	}
+	return inverse_document_freqs_[term_id].Get(document_count_, document_freqs_[term_id]);
+}
+
+uint64_t CorpusStats::GetVersion() const {
+	return version_;
+}
+
+int CorpusStats::AddWord(std::string_view word) {
+	const int term_id = dictionary_.AddTerm(word);
+	if (static_cast<size_t>(term_id) >= document_freqs_.size()) {
+		document_freqs_.resize(term_id + 1);
+		inverse_document_freqs_.resize(term_id + 1);
+	}
+	return term_id;
+}
+
+void CorpusStats::RemoveWord(std::string_view word) {
+	const int term_id = dictionary_.GetTermId(word);
+	if (--document_freqs_[term_id] == 0) {
+		dictionary_.RemoveTerm(term_id);
+	}
+}
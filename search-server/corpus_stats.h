@@ -0,0 +1,49 @@
+#pragma once
+#include "inverted_index.h"
+#include "term_dictionary.h"
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Document frequencies summed over several SearchServers holding parts of one
+// corpus, so each part can score with the IDF of the whole corpus.
+class CorpusStats {
+public:
+	void AddDocument(const std::map<std::string_view, double>& word_freqs);
+
+	void AddDocument(const std::vector<std::string_view>& words);
+
+	void RemoveDocument(const std::map<std::string_view, double>& word_freqs);
+
+	void RemoveDocument(const std::vector<std::string_view>& words);
+
+	// For stats aggregated elsewhere, e.g. sent along with a query.
+	void SetDocumentCount(int document_count);
+
+	void SetDocumentFreq(std::string_view word, int document_freq);
+
+	int GetDocumentCount() const;
+
+	int GetDocumentFreq(std::string_view word) const;
+
+	// log(document count / documents containing word), or std::nullopt when no
+	// counted document contains word: stats sent by a router may lack local words.
+	std::optional<double> FindInverseDocumentFreq(std::string_view word) const;
+
+	// Changes whenever a count changes.
+	uint64_t GetVersion() const;
+
+private:
+	TermDictionary dictionary_;
+	std::vector<int> document_freqs_;
+	std::vector<InverseDocumentFreqCache> inverse_document_freqs_;
+	int document_count_ = 0;
+	uint64_t version_ = 0;
+
+	int AddWord(std::string_view word);
+
+	void RemoveWord(std::string_view word);
+};
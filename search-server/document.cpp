@@ -1,11 +1,21 @@
 #include "document.h"
 
+#include <numeric>
+
 Document::Document(int id, double relevance, int rating)
 	: id(id)
 	, relevance(relevance)
 	, rating(rating) {
 }
 
+int ComputeAverageRating(const std::vector<int>& ratings) {
+	if (ratings.empty()) {
+		return 0;
+	}
+	int rating_sum = std::accumulate(ratings.begin(), ratings.end(), 0);
+	return rating_sum / static_cast<int>(ratings.size());
+}
+
 std::ostream& operator<< (std::ostream& output, const Document& doc) {
 	std::cout << "{ document_id = " << doc.id << ", relevance = " << doc.relevance << ", rating = " << doc.rating << " }";
 	return output;
@@ -1,5 +1,7 @@
 #pragma once
 #include <iostream>
+#include <string_view>
+#include <vector>
 
 struct Document {
 	Document() = default;
@@ -13,9 +15,31 @@ struct Document {
 
 std::ostream& operator<< (std::ostream& output, const Document& doc);
 
+// Integer mean of the ratings, 0 when there are none.
+int ComputeAverageRating(const std::vector<int>& ratings);
+
 enum class DocumentStatus {
 	ACTUAL,
 	IRRELEVANT,
 	BANNED,
 	REMOVED,
+};
+
+const size_t DOCUMENT_STATUS_COUNT = 4;
+
+// A status-only predicate. SearchServer recognizes the type and tests its
+// per-status bitmap instead of calling the predicate for every posting.
+struct DocumentStatusFilter {
+	DocumentStatus status;
+
+	bool operator()(int, DocumentStatus document_status, int) const {
+		return document_status == status;
+	}
+};
+
+struct RawDocument {
+	int id = 0;
+	std::string_view text;
+	DocumentStatus status = DocumentStatus::ACTUAL;
+	std::vector<int> ratings;
 };
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "index_segment.h"
+
+void IndexSegment::AddDocument(const SegmentDocument& document, const std::vector<std::pair<int, uint32_t>>& term_counts) {
+	const int ordinal = static_cast<int>(documents_.size());
+	documents_.push_back(document);
+	tombstones_.push_back(false);
+	for (const auto& [term_id, term_count] : term_counts) {
+		if (static_cast<size_t>(term_id) >= open_postings_.size()) {
+			open_postings_.resize(term_id + 1);
+		}
+		open_postings_[term_id].push_back({ ordinal, term_count });
+		document_terms_.push_back(term_id);
+		document_term_counts_.push_back(term_count);
+	}
+	document_term_bounds_.push_back(document_terms_.size());
+}
+
+void IndexSegment::Seal() {
+	term_posting_bounds_.push_back(0);
+	for (size_t term_id = 0; term_id < open_postings_.size(); ++term_id) {
+		int previous_ordinal = 0;
+		for (const auto& [ordinal, term_count] : open_postings_[term_id]) {
+			if (tombstones_[ordinal]) {
+				continue;
+			}
+			EncodePosting(ordinal - previous_ordinal, term_count, posting_bytes_);
+			previous_ordinal = ordinal;
+		}
+		if (posting_bytes_.size() > term_posting_bounds_.back()) {
+			terms_.push_back(static_cast<int>(term_id));
+			term_posting_bounds_.push_back(posting_bytes_.size());
+		}
+	}
+	open_postings_.clear();
+	open_postings_.shrink_to_fit();
+	posting_bytes_.shrink_to_fit();
+	sealed_ = true;
+}
+
+bool IndexSegment::IsSealed() const {
+	return sealed_;
+}
+
+void IndexSegment::Delete(int ordinal) {
+	if (!tombstones_[ordinal]) {
+		tombstones_[ordinal] = true;
+		++deleted_count_;
+	}
+}
+
+bool IndexSegment::IsDeleted(int ordinal) const {
+	return tombstones_[ordinal];
+}
+
+const std::vector<bool>& IndexSegment::GetTombstones() const {
+	return tombstones_;
+}
+
+size_t IndexSegment::GetDocumentCount() const {
+	return documents_.size();
+}
+
+size_t IndexSegment::GetLiveDocumentCount() const {
+	return documents_.size() - deleted_count_;
+}
+
+const SegmentDocument& IndexSegment::GetDocument(int ordinal) const {
+	return documents_[ordinal];
+}
+
+bool IndexSegment::HasTerm(int ordinal, int term_id) const {
+	return std::binary_search(document_terms_.begin() + document_term_bounds_[ordinal],
+		document_terms_.begin() + document_term_bounds_[ordinal + 1], term_id);
+}
+
+size_t IndexSegment::GetMemoryUsage() const {
+	size_t memory_usage = documents_.capacity() * sizeof(SegmentDocument) + tombstones_.capacity() / 8
+		+ document_term_bounds_.capacity() * sizeof(size_t) + document_terms_.capacity() * sizeof(int)
+		+ document_term_counts_.capacity() * sizeof(uint32_t) + terms_.capacity() * sizeof(int)
+		+ term_posting_bounds_.capacity() * sizeof(size_t) + posting_bytes_.capacity();
+	for (const auto& postings : open_postings_) {
+		memory_usage += sizeof(postings) + postings.capacity() * sizeof(postings[0]);
+	}
+	return memory_usage;
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include "document.h"
+#include "posting_codec.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+struct SegmentDocument {
+	int id = 0;
+	int rating = 0;
+	DocumentStatus status = DocumentStatus::ACTUAL;
+	uint32_t length = 0;
+};
+
+// Documents are numbered by ordinal in the order they were added. A segment
+// takes documents until Seal packs its postings into varint-encoded lists
+// (posting_codec.h); after that only Delete, which leaves a tombstone, changes it.
+// Term ids come from the owner's dictionary.
+class IndexSegment {
+public:
+	// term_counts holds (term id, occurrences) pairs sorted by term id.
+	void AddDocument(const SegmentDocument& document, const std::vector<std::pair<int, uint32_t>>& term_counts);
+
+	void Seal();
+
+	bool IsSealed() const;
+
+	void Delete(int ordinal);
+
+	bool IsDeleted(int ordinal) const;
+
+	const std::vector<bool>& GetTombstones() const;
+
+	// Deleted documents included.
+	size_t GetDocumentCount() const;
+
+	size_t GetLiveDocumentCount() const;
+
+	const SegmentDocument& GetDocument(int ordinal) const;
+
+	bool HasTerm(int ordinal, int term_id) const;
+
+	template <typename TermHandler>
+	void ForEachTerm(int ordinal, TermHandler handle_term) const;
+
+	// Calls handle_posting(ordinal, term_freq) for live documents containing term_id.
+	template <typename PostingHandler>
+	void ForEachPosting(int term_id, PostingHandler handle_posting) const;
+
+	size_t GetMemoryUsage() const;
+
+private:
+	std::vector<SegmentDocument> documents_;
+	std::vector<bool> tombstones_;
+	size_t deleted_count_ = 0;
+	std::vector<size_t> document_term_bounds_ = { 0 };
+	std::vector<int> document_terms_;
+	std::vector<uint32_t> document_term_counts_;
+	bool sealed_ = false;
+	// Before Seal: (ordinal, occurrences) per term id.
+	std::vector<std::vector<std::pair<int, uint32_t>>> open_postings_;
+	// After Seal: sorted term ids and their byte ranges in posting_bytes_.
+	std::vector<int> terms_;
+	std::vector<size_t> term_posting_bounds_;
+	std::vector<uint8_t> posting_bytes_;
+};
+
+template <typename TermHandler>
+void IndexSegment::ForEachTerm(int ordinal, TermHandler handle_term) const {
+	for (size_t i = document_term_bounds_[ordinal]; i < document_term_bounds_[ordinal + 1]; ++i) {
+		handle_term(document_terms_[i], document_term_counts_[i]);
+	}
+}
+
+template <typename PostingHandler>
+void IndexSegment::ForEachPosting(int term_id, PostingHandler handle_posting) const {
+	const auto handle_live_posting = [&](int ordinal, uint32_t term_count) {
+		if (!tombstones_[ordinal]) {
+			handle_posting(ordinal, term_count * (1.0 / documents_[ordinal].length));
+		}
+	};
+	if (!sealed_) {
+		if (static_cast<size_t>(term_id) < open_postings_.size()) {
+			for (const auto& [ordinal, term_count] : open_postings_[term_id]) {
+				handle_live_posting(ordinal, term_count);
+			}
+		}
+		return;
+	}
+	const auto term = std::lower_bound(terms_.begin(), terms_.end(), term_id);
+	if (term == terms_.end() || *term != term_id) {
+		return;
+	}
+	const size_t term_index = term - terms_.begin();
+	const uint8_t* position = posting_bytes_.data() + term_posting_bounds_[term_index];
+	const uint8_t* const last = posting_bytes_.data() + term_posting_bounds_[term_index + 1];
+	uint32_t ordinal = 0;
+	while (position != last) {
+		uint32_t ordinal_delta;
+		uint32_t term_count;
+		position = DecodePosting(position, ordinal_delta, term_count);
+		ordinal += ordinal_delta;
+		handle_live_posting(static_cast<int>(ordinal), term_count);
+	}
+}
@@ -0,0 +1,354 @@
+#include "index_snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+class SnapshotWriter {
+public:
+	explicit SnapshotWriter(const std::string& path)
+		: out_(path, std::ios::binary | std::ios::trunc) {
+		if (!out_) {
+			throw std::runtime_error("Не удалось создать снимок");
+		}
+	}
+
+	template <typename T>
+	uint64_t WriteSection(const T* data, size_t count) {
+		Align();
+		const uint64_t offset = position_;
+		Write(data, count * sizeof(T));
+		return offset;
+	}
+
+	void WriteAt(uint64_t offset, const void* data, size_t size) {
+		out_.seekp(offset);
+		out_.write(static_cast<const char*>(data), size);
+		out_.seekp(position_);
+	}
+
+	uint64_t Finish() {
+		Align();
+		out_.flush();
+		if (!out_) {
+			throw std::runtime_error("Ошибка записи снимка");
+		}
+		return position_;
+	}
+
+private:
+	std::ofstream out_;
+	uint64_t position_ = 0;
+
+	void Write(const void* data, size_t size) {
+		out_.write(static_cast<const char*>(data), size);
+		position_ += size;
+	}
+
+	void Align() {
+		static const char padding[8] = {};
+		Write(padding, (8 - position_ % 8) % 8);
+	}
+};
+
+// DecodeVarint that stops at end and at values wider than 32 bits.
+bool DecodeVarint(const uint8_t*& in, const uint8_t* end, uint32_t& value) {
+	value = 0;
+	for (int shift = 0; shift < 32 && in != end; shift += 7) {
+		const uint32_t byte = *in++;
+		value |= (byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+template <typename Bound>
+std::vector<Bound> BuildStringBounds(const std::vector<std::string_view>& words, std::string& strings) {
+	std::vector<Bound> bounds;
+	bounds.reserve(words.size() + 1);
+	for (std::string_view word : words) {
+		bounds.push_back(static_cast<Bound>(strings.size()));
+		strings += word;
+	}
+	bounds.push_back(static_cast<Bound>(strings.size()));
+	return bounds;
+}
+
+}
+
+void WriteSnapshot(const SnapshotData& data, const std::string& path) {
+	std::string strings;
+	const std::vector<uint32_t> stop_word_bounds = BuildStringBounds<uint32_t>(data.stop_words, strings);
+	std::vector<uint64_t> term_bounds = BuildStringBounds<uint64_t>(data.terms, strings);
+	for (uint64_t& bound : term_bounds) {
+		bound -= stop_word_bounds.back();
+	}
+
+	SnapshotHeader header = {};
+	std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+	header.version = SNAPSHOT_VERSION;
+	header.document_count = static_cast<uint32_t>(data.document_ids.size());
+	header.term_count = static_cast<uint32_t>(data.terms.size());
+	header.stop_word_count = static_cast<uint32_t>(data.stop_words.size());
+	header.posting_format = static_cast<uint32_t>(data.posting_format);
+	header.posting_count = data.term_posting_bounds.empty() ? 0 : data.term_posting_bounds.back();
+	header.posting_bytes = data.posting_bytes.size();
+	header.document_term_count = data.document_terms.size();
+	header.string_bytes = strings.size();
+
+	SnapshotWriter writer(path);
+	writer.WriteSection(&header, 1);
+	header.strings = writer.WriteSection(strings.data(), strings.size());
+	header.stop_word_bounds = writer.WriteSection(stop_word_bounds.data(), stop_word_bounds.size());
+	header.term_bounds = writer.WriteSection(term_bounds.data(), term_bounds.size());
+	header.term_posting_bounds = writer.WriteSection(data.term_posting_bounds.data(), data.term_posting_bounds.size());
+	header.term_max_freqs = writer.WriteSection(data.term_max_freqs.data(), data.term_max_freqs.size());
+	header.posting_ordinals = writer.WriteSection(data.posting_ordinals.data(), data.posting_ordinals.size());
+	header.posting_term_freqs = writer.WriteSection(data.posting_term_freqs.data(), data.posting_term_freqs.size());
+	header.term_posting_byte_bounds = writer.WriteSection(data.term_posting_byte_bounds.data(), data.term_posting_byte_bounds.size());
+	header.posting_data = writer.WriteSection(data.posting_bytes.data(), data.posting_bytes.size());
+	header.document_ids = writer.WriteSection(data.document_ids.data(), data.document_ids.size());
+	header.document_ratings = writer.WriteSection(data.document_ratings.data(), data.document_ratings.size());
+	header.document_statuses = writer.WriteSection(data.document_statuses.data(), data.document_statuses.size());
+	header.document_lengths = writer.WriteSection(data.document_lengths.data(), data.document_lengths.size());
+	header.document_term_bounds = writer.WriteSection(data.document_term_bounds.data(), data.document_term_bounds.size());
+	header.document_terms = writer.WriteSection(data.document_terms.data(), data.document_terms.size());
+	header.file_size = writer.Finish();
+	writer.WriteAt(0, &header, sizeof(header));
+	writer.Finish();
+}
+
+IndexSnapshot::IndexSnapshot(const std::string& path) {
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Не удалось открыть снимок");
+	}
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(SnapshotHeader)) {
+		close(fd);
+		throw std::runtime_error("Неверный формат снимка");
+	}
+	size_ = file_stat.st_size;
+	void* mapped = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED) {
+		throw std::runtime_error("Не удалось отобразить снимок");
+	}
+	data_ = static_cast<const char*>(mapped);
+	header_ = reinterpret_cast<const SnapshotHeader*>(data_);
+	try {
+		if (std::memcmp(header_->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0
+			|| header_->version != SNAPSHOT_VERSION || header_->file_size != size_) {
+			throw std::runtime_error("Неверный формат снимка");
+		}
+		strings_ = GetSection<char>(header_->strings, header_->string_bytes);
+		stop_word_bounds_ = GetSection<uint32_t>(header_->stop_word_bounds, header_->stop_word_count + 1ull);
+		term_bounds_ = GetSection<uint64_t>(header_->term_bounds, header_->term_count + 1ull);
+		term_posting_bounds_ = GetSection<uint64_t>(header_->term_posting_bounds, header_->term_count + 1ull);
+		term_max_freqs_ = GetSection<double>(header_->term_max_freqs, header_->term_count);
+		if (header_->posting_format == static_cast<uint32_t>(PostingFormat::RAW)) {
+			posting_ordinals_ = GetSection<int32_t>(header_->posting_ordinals, header_->posting_count);
+			posting_term_freqs_ = GetSection<double>(header_->posting_term_freqs, header_->posting_count);
+		}
+		else if (header_->posting_format == static_cast<uint32_t>(PostingFormat::COMPRESSED)) {
+			term_posting_byte_bounds_ = GetSection<uint64_t>(header_->term_posting_byte_bounds, header_->term_count + 1ull);
+			posting_data_ = GetSection<uint8_t>(header_->posting_data, header_->posting_bytes);
+			document_lengths_ = GetSection<uint32_t>(header_->document_lengths, header_->document_count);
+			if (term_posting_byte_bounds_[header_->term_count] != header_->posting_bytes) {
+				throw std::runtime_error("Неверный формат снимка");
+			}
+		}
+		else {
+			throw std::runtime_error("Неверный формат снимка");
+		}
+		document_ids_ = GetSection<int32_t>(header_->document_ids, header_->document_count);
+		document_ratings_ = GetSection<int32_t>(header_->document_ratings, header_->document_count);
+		document_statuses_ = GetSection<int32_t>(header_->document_statuses, header_->document_count);
+		document_term_bounds_ = GetSection<uint64_t>(header_->document_term_bounds, header_->document_count + 1ull);
+		document_terms_ = GetSection<int32_t>(header_->document_terms, header_->document_term_count);
+		Validate();
+	}
+	catch (...) {
+		munmap(const_cast<char*>(data_), size_);
+		throw;
+	}
+}
+
+IndexSnapshot::~IndexSnapshot() {
+	munmap(const_cast<char*>(data_), size_);
+}
+
+std::vector<Document> IndexSnapshot::FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t top_count) const {
+	return FindTopDocuments(raw_query, DocumentStatusFilter{ status }, top_count);
+}
+
+std::vector<Document> IndexSnapshot::FindTopDocuments(std::string_view raw_query) const {
+	return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> IndexSnapshot::MatchDocument(std::string_view raw_query, int document_id) const {
+	if (!IsValidText(raw_query)) {
+		throw std::invalid_argument("Спецсимвол");
+	}
+	const int32_t* document = std::lower_bound(begin(), end(), document_id);
+	if (document == end() || *document != document_id) {
+		throw std::out_of_range("Нет ID");
+	}
+	const size_t ordinal = document - begin();
+	const DocumentStatus status = static_cast<DocumentStatus>(document_statuses_[ordinal]);
+	const int32_t* first_term = document_terms_ + document_term_bounds_[ordinal];
+	const int32_t* last_term = document_terms_ + document_term_bounds_[ordinal + 1];
+	const Query& query = ParseQuery(raw_query);
+	std::vector<std::string_view> matched_words;
+	for (std::string_view word : query.minus_words) {
+		const int term = FindTerm(word);
+		if (term >= 0 && std::binary_search(first_term, last_term, term)) {
+			return { matched_words, status };
+		}
+	}
+	for (std::string_view word : query.plus_words) {
+		const int term = FindTerm(word);
+		if (term >= 0 && std::binary_search(first_term, last_term, term)) {
+			matched_words.push_back(GetTerm(term));
+		}
+	}
+	return { matched_words, status };
+}
+
+int IndexSnapshot::GetDocumentCount() const {
+	return static_cast<int>(header_->document_count);
+}
+
+size_t IndexSnapshot::GetPostingCount() const {
+	return header_->posting_count;
+}
+
+size_t IndexSnapshot::GetPostingBytes() const {
+	if (header_->posting_format == static_cast<uint32_t>(PostingFormat::RAW)) {
+		return header_->posting_count * (sizeof(int32_t) + sizeof(double));
+	}
+	return header_->posting_bytes + header_->document_count * sizeof(uint32_t);
+}
+
+template <typename T>
+const T* IndexSnapshot::GetSection(uint64_t offset, uint64_t count) const {
+	if (offset % alignof(T) != 0 || offset > size_ || count > (size_ - offset) / sizeof(T)) {
+		throw std::runtime_error("Неверный формат снимка");
+	}
+	return reinterpret_cast<const T*>(data_ + offset);
+}
+
+void IndexSnapshot::Validate() const {
+	const auto is_ascending = [](const auto* bounds, uint64_t count) {
+		return std::is_sorted(bounds, bounds + count);
+	};
+	const auto is_below = [](const int32_t* values, uint64_t count, uint32_t limit) {
+		return std::all_of(values, values + count, [limit](int32_t value) {
+			return value >= 0 && static_cast<uint32_t>(value) < limit;
+			});
+	};
+	if (!is_ascending(stop_word_bounds_, header_->stop_word_count + 1ull)
+		|| !is_ascending(term_bounds_, header_->term_count + 1ull)
+		|| !is_ascending(term_posting_bounds_, header_->term_count + 1ull)
+		|| !is_ascending(document_term_bounds_, header_->document_count + 1ull)
+		|| term_bounds_[header_->term_count] > header_->string_bytes
+		|| stop_word_bounds_[header_->stop_word_count] + term_bounds_[header_->term_count] != header_->string_bytes
+		|| term_posting_bounds_[header_->term_count] != header_->posting_count
+		|| document_term_bounds_[header_->document_count] != header_->document_term_count
+		|| !is_below(document_terms_, header_->document_term_count, header_->term_count)
+		|| !is_below(document_statuses_, header_->document_count, static_cast<uint32_t>(DOCUMENT_STATUS_COUNT))) {
+		throw std::runtime_error("Неверный формат снимка");
+	}
+	if (posting_ordinals_ != nullptr) {
+		if (!is_below(posting_ordinals_, header_->posting_count, header_->document_count)) {
+			throw std::runtime_error("Неверный формат снимка");
+		}
+		return;
+	}
+	if (!is_ascending(term_posting_byte_bounds_, header_->term_count + 1ull)) {
+		throw std::runtime_error("Неверный формат снимка");
+	}
+	for (uint32_t term = 0; term < header_->term_count; ++term) {
+		const uint8_t* position = posting_data_ + term_posting_byte_bounds_[term];
+		const uint8_t* const end = posting_data_ + term_posting_byte_bounds_[term + 1];
+		uint64_t ordinal = 0;
+		for (uint64_t i = term_posting_bounds_[term]; i < term_posting_bounds_[term + 1]; ++i) {
+			uint32_t ordinal_delta;
+			uint32_t term_count;
+			if (!DecodeVarint(position, end, ordinal_delta) || !DecodeVarint(position, end, term_count)
+				|| (ordinal += ordinal_delta) >= header_->document_count) {
+				throw std::runtime_error("Неверный формат снимка");
+			}
+		}
+		if (position != end) {
+			throw std::runtime_error("Неверный формат снимка");
+		}
+	}
+}
+
+std::string_view IndexSnapshot::GetTerm(int term) const {
+	const char* terms = strings_ + stop_word_bounds_[header_->stop_word_count];
+	return { terms + term_bounds_[term], term_bounds_[term + 1] - term_bounds_[term] };
+}
+
+int IndexSnapshot::FindTerm(std::string_view word) const {
+	int first = 0;
+	int last = static_cast<int>(header_->term_count);
+	while (first < last) {
+		const int middle = first + (last - first) / 2;
+		if (GetTerm(middle) < word) {
+			first = middle + 1;
+		}
+		else {
+			last = middle;
+		}
+	}
+	if (first < static_cast<int>(header_->term_count) && GetTerm(first) == word) {
+		return first;
+	}
+	return -1;
+}
+
+bool IndexSnapshot::IsStopWord(std::string_view word) const {
+	const auto get_stop_word = [this](uint32_t i) {
+		return std::string_view(strings_ + stop_word_bounds_[i], stop_word_bounds_[i + 1] - stop_word_bounds_[i]);
+	};
+	uint32_t first = 0;
+	uint32_t last = header_->stop_word_count;
+	while (first < last) {
+		const uint32_t middle = first + (last - first) / 2;
+		if (get_stop_word(middle) < word) {
+			first = middle + 1;
+		}
+		else {
+			last = middle;
+		}
+	}
+	return first < header_->stop_word_count && get_stop_word(first) == word;
+}
+
+const Query& IndexSnapshot::ParseQuery(std::string_view text) const {
+	thread_local Query query;
+	ParseRawQuery(text, true, [this](std::string_view word) {
+		return IsStopWord(word);
+		}, query);
+	return query;
+}
+
+std::vector<double>& IndexSnapshot::GetRelevanceScratch(size_t size) {
+	thread_local std::vector<double> relevance;
+	if (relevance.size() < size) {
+		relevance.resize(size, RELEVANCE_NOT_MATCHED);
+	}
+	return relevance;
+}
@@ -0,0 +1,212 @@
+#pragma once
+#include "search_server.h"
+#include "posting_codec.h"
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+const char SNAPSHOT_MAGIC[8] = { 'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P' };
+const uint32_t SNAPSHOT_VERSION = 2;
+
+struct SnapshotHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t document_count;
+	uint32_t term_count;
+	uint32_t stop_word_count;
+	uint32_t posting_format;
+	uint32_t reserved;
+	uint64_t posting_count;
+	uint64_t posting_bytes;
+	uint64_t document_term_count;
+	uint64_t string_bytes;
+	uint64_t strings;
+	uint64_t stop_word_bounds;
+	uint64_t term_bounds;
+	uint64_t term_posting_bounds;
+	uint64_t term_max_freqs;
+	uint64_t posting_ordinals;
+	uint64_t posting_term_freqs;
+	uint64_t term_posting_byte_bounds;
+	uint64_t posting_data;
+	uint64_t document_ids;
+	uint64_t document_ratings;
+	uint64_t document_statuses;
+	uint64_t document_lengths;
+	uint64_t document_term_bounds;
+	uint64_t document_terms;
+	uint64_t file_size;
+};
+
+// Everything is ordered so the mapped file can be searched directly: terms and
+// stop words lexicographically, documents by id (ordinal == position), postings
+// and per-document term lists ascending. RAW postings fill posting_ordinals and
+// posting_term_freqs, COMPRESSED ones fill posting_bytes and its per-term bounds.
+struct SnapshotData {
+	PostingFormat posting_format = PostingFormat::RAW;
+	std::vector<std::string_view> stop_words;
+	std::vector<std::string_view> terms;
+	std::vector<uint64_t> term_posting_bounds;
+	std::vector<double> term_max_freqs;
+	std::vector<int32_t> posting_ordinals;
+	std::vector<double> posting_term_freqs;
+	std::vector<uint64_t> term_posting_byte_bounds;
+	std::vector<uint8_t> posting_bytes;
+	std::vector<int32_t> document_ids;
+	std::vector<int32_t> document_ratings;
+	std::vector<int32_t> document_statuses;
+	std::vector<uint32_t> document_lengths;
+	std::vector<uint64_t> document_term_bounds;
+	std::vector<int32_t> document_terms;
+};
+
+void WriteSnapshot(const SnapshotData& data, const std::string& path);
+
+class IndexSnapshot {
+public:
+	// Maps the file and checks it in one pass over the index; throws
+	// std::runtime_error on a malformed file, so queries never read out of bounds.
+	explicit IndexSnapshot(const std::string& path);
+
+	IndexSnapshot(const IndexSnapshot&) = delete;
+
+	IndexSnapshot& operator=(const IndexSnapshot&) = delete;
+
+	~IndexSnapshot();
+
+	template <typename DocumentPredicate>
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+	std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+	int GetDocumentCount() const;
+
+	size_t GetPostingCount() const;
+
+	// Bytes taken by posting data (ordinals and frequencies) in the chosen format.
+	size_t GetPostingBytes() const;
+
+	const int32_t* begin() const {
+		return document_ids_;
+	}
+
+	const int32_t* end() const {
+		return document_ids_ + header_->document_count;
+	}
+
+private:
+	const char* data_ = nullptr;
+	size_t size_ = 0;
+	const SnapshotHeader* header_ = nullptr;
+	const char* strings_ = nullptr;
+	const uint32_t* stop_word_bounds_ = nullptr;
+	const uint64_t* term_bounds_ = nullptr;
+	const uint64_t* term_posting_bounds_ = nullptr;
+	const double* term_max_freqs_ = nullptr;
+	const int32_t* posting_ordinals_ = nullptr;
+	const double* posting_term_freqs_ = nullptr;
+	const uint64_t* term_posting_byte_bounds_ = nullptr;
+	const uint8_t* posting_data_ = nullptr;
+	const int32_t* document_ids_ = nullptr;
+	const int32_t* document_ratings_ = nullptr;
+	const int32_t* document_statuses_ = nullptr;
+	const uint32_t* document_lengths_ = nullptr;
+	const uint64_t* document_term_bounds_ = nullptr;
+	const int32_t* document_terms_ = nullptr;
+
+	template <typename T>
+	const T* GetSection(uint64_t offset, uint64_t count) const;
+
+	// Bounds ascending, term ids, posting ordinals and statuses within the
+	// header counts, every compressed posting list ending at its byte bound.
+	void Validate() const;
+
+	std::string_view GetTerm(int term) const;
+
+	int FindTerm(std::string_view word) const;
+
+	bool IsStopWord(std::string_view word) const;
+
+	template <typename PostingHandler>
+	void ForEachPosting(int term, PostingHandler handle_posting) const;
+
+	const Query& ParseQuery(std::string_view text) const;
+
+	static std::vector<double>& GetRelevanceScratch(size_t size);
+};
+
+template <typename DocumentPredicate>
+std::vector<Document> IndexSnapshot::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t top_count) const {
+	const Query& query = ParseQuery(raw_query);
+	std::vector<double>& relevance = GetRelevanceScratch(header_->document_count);
+	std::vector<int> touched;
+	for (std::string_view word : query.plus_words) {
+		const int term = FindTerm(word);
+		if (term < 0 || term_posting_bounds_[term] == term_posting_bounds_[term + 1]) {
+			continue;
+		}
+		const double inverse_document_freq = std::log(GetDocumentCount() * 1.0 / (term_posting_bounds_[term + 1] - term_posting_bounds_[term]));
+		ForEachPosting(term, [&](int ordinal, double term_freq) {
+			if (term_freq == 0 || relevance[ordinal] == RELEVANCE_EXCLUDED) {
+				return;
+			}
+			if (relevance[ordinal] == RELEVANCE_NOT_MATCHED) {
+				touched.push_back(ordinal);
+				if (!document_predicate(document_ids_[ordinal], static_cast<DocumentStatus>(document_statuses_[ordinal]), document_ratings_[ordinal])) {
+					relevance[ordinal] = RELEVANCE_EXCLUDED;
+					return;
+				}
+				relevance[ordinal] = 0;
+			}
+			relevance[ordinal] += term_freq * inverse_document_freq;
+			});
+	}
+	for (std::string_view word : query.minus_words) {
+		const int term = FindTerm(word);
+		if (term < 0) {
+			continue;
+		}
+		ForEachPosting(term, [&relevance](int ordinal, double) {
+			if (relevance[ordinal] >= 0) {
+				relevance[ordinal] = RELEVANCE_EXCLUDED;
+			}
+			});
+	}
+	TopDocuments top_documents(top_count);
+	for (const int ordinal : touched) {
+		if (relevance[ordinal] >= 0) {
+			top_documents.Add({ document_ids_[ordinal], relevance[ordinal], document_ratings_[ordinal] });
+		}
+		relevance[ordinal] = RELEVANCE_NOT_MATCHED;
+	}
+	return top_documents.Extract();
+}
+
+template <typename PostingHandler>
+void IndexSnapshot::ForEachPosting(int term, PostingHandler handle_posting) const {
+	const uint64_t first = term_posting_bounds_[term];
+	const uint64_t last = term_posting_bounds_[term + 1];
+	if (header_->posting_format == static_cast<uint32_t>(PostingFormat::RAW)) {
+		for (uint64_t i = first; i < last; ++i) {
+			handle_posting(posting_ordinals_[i], posting_term_freqs_[i]);
+		}
+		return;
+	}
+	const uint8_t* position = posting_data_ + term_posting_byte_bounds_[term];
+	uint32_t ordinal = 0;
+	for (uint64_t i = first; i < last; ++i) {
+		uint32_t ordinal_delta;
+		uint32_t term_count;
+		position = DecodePosting(position, ordinal_delta, term_count);
+		ordinal += ordinal_delta;
+		handle_posting(static_cast<int>(ordinal), term_count * (1.0 / document_lengths_[ordinal]));
+	}
+}
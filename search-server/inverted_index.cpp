@@ -0,0 +1,133 @@
+#include "inverted_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+double InverseDocumentFreqCache::Get(int document_count, size_t document_freq) const {
+	const uint64_t key = static_cast<uint64_t>(document_count) << 32 | document_freq;
+	if (key_.load(std::memory_order_acquire) == key) {
+		return value_.load(std::memory_order_relaxed);
+	}
+	const double value = std::log(document_count * 1.0 / document_freq);
+	value_.store(value, std::memory_order_relaxed);
+	key_.store(key, std::memory_order_release);
+	return value;
+}
+
+int InvertedIndex::GetTermId(std::string_view word) const {
+	return dictionary_.GetTermId(word);
+}
+
+int InvertedIndex::AddTerm(std::string_view word) {
+	const int term_id = dictionary_.AddTerm(word);
+	if (static_cast<size_t>(term_id) >= postings_.size()) {
+		postings_.resize(term_id + 1);
+	}
+	return term_id;
+}
+
+std::string_view InvertedIndex::GetTerm(int term_id) const {
+	return dictionary_.GetTerm(term_id);
+}
+
+size_t InvertedIndex::GetTermIdBound() const {
+	return dictionary_.GetTermIdBound();
+}
+
+void InvertedIndex::ReleaseTermIfUnused(int term_id) {
+	if (!postings_[term_id].empty()) {
+		return;
+	}
+	postings_[term_id] = PostingList();
+	dictionary_.RemoveTerm(term_id);
+}
+
+bool InvertedIndex::NeedsTermCompaction() const {
+	return dictionary_.NeedsCompaction();
+}
+
+TermDictionary::Arena InvertedIndex::CompactTerms() {
+	return dictionary_.Compact();
+}
+
+void InvertedIndex::AddPosting(int term_id, int document_ordinal, double term_freq) {
+	PostingList& postings = postings_[term_id];
+	if (postings.empty() || postings.document_ordinals.back() < document_ordinal) {
+		postings.document_ordinals.push_back(document_ordinal);
+		postings.term_freqs.push_back(term_freq);
+		postings.max_term_freq = std::max(postings.max_term_freq, term_freq);
+		return;
+	}
+	const auto it = std::lower_bound(postings.document_ordinals.begin(), postings.document_ordinals.end(), document_ordinal);
+	const auto offset = std::distance(postings.document_ordinals.begin(), it);
+	if (it != postings.document_ordinals.end() && *it == document_ordinal) {
+		postings.term_freqs[offset] += term_freq;
+		postings.max_term_freq = std::max(postings.max_term_freq, postings.term_freqs[offset]);
+		return;
+	}
+	postings.document_ordinals.insert(it, document_ordinal);
+	postings.term_freqs.insert(postings.term_freqs.begin() + offset, term_freq);
+	postings.max_term_freq = std::max(postings.max_term_freq, term_freq);
+}
+
+void InvertedIndex::RemovePosting(int term_id, int document_ordinal) {
+	PostingList& postings = postings_[term_id];
+	const auto it = std::lower_bound(postings.document_ordinals.begin(), postings.document_ordinals.end(), document_ordinal);
+	if (it == postings.document_ordinals.end() || *it != document_ordinal) {
+		return;
+	}
+	const auto offset = std::distance(postings.document_ordinals.begin(), it);
+	const double term_freq = postings.term_freqs[offset];
+	postings.document_ordinals.erase(it);
+	postings.term_freqs.erase(postings.term_freqs.begin() + offset);
+	if (term_freq >= postings.max_term_freq) {
+		postings.max_term_freq = postings.empty() ? 0 : *std::max_element(postings.term_freqs.begin(), postings.term_freqs.end());
+	}
+}
+
+void InvertedIndex::RemovePostings(int term_id, const std::vector<bool>& is_removed) {
+	PostingList& postings = postings_[term_id];
+	size_t kept = 0;
+	double max_term_freq = 0;
+	for (size_t i = 0; i < postings.size(); ++i) {
+		if (is_removed[postings.document_ordinals[i]]) {
+			continue;
+		}
+		postings.document_ordinals[kept] = postings.document_ordinals[i];
+		postings.term_freqs[kept] = postings.term_freqs[i];
+		max_term_freq = std::max(max_term_freq, postings.term_freqs[i]);
+		++kept;
+	}
+	postings.document_ordinals.resize(kept);
+	postings.term_freqs.resize(kept);
+	postings.max_term_freq = max_term_freq;
+}
+
+void InvertedIndex::RemapOrdinals(const std::vector<int>& new_ordinals) {
+	for (PostingList& postings : postings_) {
+		for (int& document_ordinal : postings.document_ordinals) {
+			document_ordinal = new_ordinals[document_ordinal];
+		}
+	}
+}
+
+const InvertedIndex::PostingList& InvertedIndex::GetPostings(int term_id) const {
+	return postings_[term_id];
+}
+
+InvertedIndex::PostingList& InvertedIndex::GetPostings(int term_id) {
+	return postings_[term_id];
+}
+
+IndexStats InvertedIndex::GetStats() const {
+	IndexStats stats;
+	stats.term_count = dictionary_.GetTermCount();
+	stats.memory_usage = postings_.capacity() * sizeof(PostingList) + dictionary_.GetMemoryUsage();
+	for (const PostingList& postings : postings_) {
+		stats.posting_count += postings.size();
+		stats.memory_usage += postings.document_ordinals.capacity() * sizeof(int);
+		stats.memory_usage += postings.term_freqs.capacity() * sizeof(double);
+	}
+	return stats;
+}
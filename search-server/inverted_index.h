@@ -0,0 +1,95 @@
+#pragma once
+#include "term_dictionary.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+struct IndexStats {
+	size_t term_count = 0;
+	size_t posting_count = 0;
+	size_t memory_usage = 0;
+};
+
+// log(document_count / document_freq) for the last pair asked for. Readers running
+// at the same time see the same pair, so racing refreshes store the same value.
+class InverseDocumentFreqCache {
+public:
+	InverseDocumentFreqCache() = default;
+
+	InverseDocumentFreqCache(const InverseDocumentFreqCache&) noexcept {
+	}
+
+	InverseDocumentFreqCache& operator=(const InverseDocumentFreqCache&) noexcept {
+		key_.store(NO_KEY, std::memory_order_relaxed);
+		return *this;
+	}
+
+	double Get(int document_count, size_t document_freq) const;
+
+private:
+	static const uint64_t NO_KEY = UINT64_MAX;
+
+	mutable std::atomic<uint64_t> key_ = NO_KEY;
+	mutable std::atomic<double> value_ = 0;
+};
+
+class InvertedIndex {
+public:
+	struct PostingList {
+		std::vector<int> document_ordinals;
+		std::vector<double> term_freqs;
+		double max_term_freq = 0;
+		InverseDocumentFreqCache inverse_document_freq;
+
+		double GetInverseDocumentFreq(int document_count) const {
+			return inverse_document_freq.Get(document_count, document_ordinals.size());
+		}
+
+		size_t size() const {
+			return document_ordinals.size();
+		}
+
+		bool empty() const {
+			return document_ordinals.empty();
+		}
+	};
+
+	static const int NO_TERM = TermDictionary::NO_TERM;
+
+	int GetTermId(std::string_view word) const;
+
+	int AddTerm(std::string_view word);
+
+	std::string_view GetTerm(int term_id) const;
+
+	size_t GetTermIdBound() const;
+
+	void ReleaseTermIfUnused(int term_id);
+
+	bool NeedsTermCompaction() const;
+
+	TermDictionary::Arena CompactTerms();
+
+	void AddPosting(int term_id, int document_ordinal, double term_freq);
+
+	void RemovePosting(int term_id, int document_ordinal);
+
+	// Drops the term's postings of every ordinal flagged in is_removed.
+	void RemovePostings(int term_id, const std::vector<bool>& is_removed);
+
+	// Rewrites each posting's ordinal o as new_ordinals[o]. The mapping must keep
+	// ordinals in order, so posting lists stay sorted.
+	void RemapOrdinals(const std::vector<int>& new_ordinals);
+
+	const PostingList& GetPostings(int term_id) const;
+
+	PostingList& GetPostings(int term_id);
+
+	IndexStats GetStats() const;
+
+private:
+	TermDictionary dictionary_;
+	std::vector<PostingList> postings_;
+};
@@ -6,7 +6,8 @@
 #define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
 #define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
 #define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
-#define LOG_DURATION_STREAM(x,y) LogDuration UNIQUE_VAR_NAME_PROFILE(x)
+#define LOG_DURATION(x) LogDuration UNIQUE_VAR_NAME_PROFILE(x)
+#define LOG_DURATION_STREAM(x,y) LogDuration UNIQUE_VAR_NAME_PROFILE(x, y)
 
 class LogDuration {
 public:
@@ -22,7 +23,7 @@ public:
 
 		const auto end_time = Clock::now();
 		const auto dur = end_time - start_time_;
-		out_ << "Operation time: "s << duration_cast<nanoseconds>(dur).count() << " ns"s << std::endl;
+		out_ << id_ << ": "s << duration_cast<nanoseconds>(dur).count() << " ns"s << std::endl;
 	}
 
 private:
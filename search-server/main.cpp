@@ -1,6 +1,10 @@
 #include "search_server.h"
 #include "process_queries.h"
 #include "log_duration.h"
+#include "benchmark.h"
+#include "corpus_generator.h"
+#include "shard_server.h"
+#include "test_example_functions.h"
 
 #include <execution>
 #include <iostream>
@@ -10,49 +14,6 @@
 
 using namespace std;
 
-string GenerateWord(mt19937& generator, int max_length) {
-	const int length = uniform_int_distribution(1, max_length)(generator);
-	string word;
-	word.reserve(length);
-	for (int i = 0; i < length; ++i) {
-		word.push_back(uniform_int_distribution((int)'a', (int)'z')(generator));
-	}
-	return word;
-}
-
-vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
-	vector<string> words;
-	words.reserve(word_count);
-	for (int i = 0; i < word_count; ++i) {
-		words.push_back(GenerateWord(generator, max_length));
-	}
-	words.erase(unique(words.begin(), words.end()), words.end());
-	return words;
-}
-
-string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob = 0) {
-	string query;
-	for (int i = 0; i < word_count; ++i) {
-		if (!query.empty()) {
-			query.push_back(' ');
-		}
-		if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
-			query.push_back('-');
-		}
-		query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
-	}
-	return query;
-}
-
-vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
-	vector<string> queries;
-	queries.reserve(query_count);
-	for (int i = 0; i < query_count; ++i) {
-		queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
-	}
-	return queries;
-}
-
 template <typename ExecutionPolicy>
 void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
 	auto test = LogDuration((std::string)mark);
@@ -67,7 +28,33 @@ void Test(string_view mark, const SearchServer& search_server, const vector<stri
 
 #define TEST(policy) Test(#policy, search_server, queries, execution::policy)
 
-int main() {
+int main(int argc, char* argv[]) {
+	if (argc == 4 && argv[1] == "--shard"sv) {
+		try {
+			ShardServer(argv[3]).Serve(argv[2]);
+		}
+		catch (const runtime_error& e) {
+			cerr << e.what() << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (argc == 2 && argv[1] == "--test"sv) {
+		TestSearchServer();
+		cerr << "All tests passed" << endl;
+		return 0;
+	}
+	if (argc >= 2 && argv[1] == "--bench"sv) {
+		try {
+			RunBenchmarks(ParseBenchmarkOptions({ argv + 2, argv + argc }), cout);
+		}
+		catch (const invalid_argument& e) {
+			cerr << e.what() << endl << "usage: " << argv[0] << " " << GetBenchmarkUsage() << endl;
+			return 1;
+		}
+		return 0;
+	}
+
 	mt19937 generator;
 
 	const auto dictionary = GenerateDictionary(generator, 1000, 10);
@@ -82,4 +69,4 @@ int main() {
 
 	TEST(seq);
 	TEST(par);
-}
\ No newline at end of file
+}
@@ -0,0 +1,14 @@
+#include "posting_codec.h"
+
+void EncodeVarint(uint32_t value, std::vector<uint8_t>& out) {
+	while (value >= 0x80) {
+		out.push_back(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+void EncodePosting(uint32_t ordinal_delta, uint32_t term_count, std::vector<uint8_t>& out) {
+	EncodeVarint(ordinal_delta, out);
+	EncodeVarint(term_count, out);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// RAW is the default. COMPRESSED snapshots are about 2.5 times smaller, but
+// queries on them run about 5% slower: every posting is decoded and its
+// frequency rebuilt. Block decoding and a table of inverse document lengths
+// did not narrow the gap, and skip data would not help exhaustive scoring,
+// which reads every posting anyway.
+enum class PostingFormat {
+	RAW,
+	COMPRESSED,
+};
+
+// LEB128: seven bits per byte, low bits first, high bit set while more bytes follow.
+void EncodeVarint(uint32_t value, std::vector<uint8_t>& out);
+
+inline const uint8_t* DecodeVarint(const uint8_t* in, uint32_t& value) {
+	uint32_t byte = *in++;
+	value = byte & 0x7F;
+	for (int shift = 7; byte & 0x80; shift += 7) {
+		byte = *in++;
+		value |= (byte & 0x7F) << shift;
+	}
+	return in;
+}
+
+// A compressed posting list is a sequence of (ordinal delta, term count) varint
+// pairs; the first delta is taken from ordinal 0. Term frequency is rebuilt as
+// term_count * (1.0 / document_length), which is how it was computed on ingest.
+void EncodePosting(uint32_t ordinal_delta, uint32_t term_count, std::vector<uint8_t>& out);
+
+inline const uint8_t* DecodePosting(const uint8_t* in, uint32_t& ordinal_delta, uint32_t& term_count) {
+	if (in[0] < 0x80 && in[1] < 0x80) {
+		ordinal_delta = in[0];
+		term_count = in[1];
+		return in + 2;
+	}
+	return DecodeVarint(DecodeVarint(in, ordinal_delta), term_count);
+}
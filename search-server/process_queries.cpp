@@ -1,28 +1,77 @@
 #include "process_queries.h"
 #include "log_duration.h"
 
+#include <numeric>
+
 std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server,const std::vector<std::string>& queries) {
 	std::vector<Document> result;
 	result.reserve(MAX_RESULT_DOCUMENT_COUNT*queries.size());
-	for (auto& el1 : ProcessQueries(search_server, queries)) {
-		for (auto& el2 : el1) {
-			result.push_back(el2);
-		}
-	}
+	ProcessQueriesJoined(GetDefaultQueryExecutor(), search_server, queries, [&result](size_t, const std::vector<Document>& documents) {
+		result.insert(result.end(), documents.begin(), documents.end());
+		});
 	return result;
 }
 
-std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries) {
-	std::vector<std::vector<Document>> result;
-	result.resize(queries.size());
-
-	for (auto& el : result) {
-		el.reserve(MAX_RESULT_DOCUMENT_COUNT);
-	}
+JoinedDocuments ProcessQueriesFlat(QueryExecutor& executor, const SearchServer& search_server, const std::vector<std::string>& queries) {
+	JoinedDocuments result;
+	result.offsets.reserve(queries.size() + 1);
+	result.offsets.push_back(0);
+	// No query returns more than MAX_RESULT_DOCUMENT_COUNT documents, so this is the only allocation.
+	result.documents.reserve(MAX_RESULT_DOCUMENT_COUNT * queries.size());
+	ProcessQueriesJoined(executor, search_server, queries, [&result](size_t, const std::vector<Document>& documents) {
+		result.documents.insert(result.documents.end(), documents.begin(), documents.end());
+		result.offsets.push_back(result.documents.size());
+		});
+	return result;
+}
 
-	auto Test = [&search_server](const std::string query) {return search_server.FindTopDocuments(query); };
+std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries) {
+	return ProcessQueries(GetDefaultQueryExecutor(), search_server, queries);
+}
 
-	std::transform(std::execution::par,queries.begin(), queries.end(), result.begin(),Test);
+std::vector<std::vector<Document>> ProcessQueries(QueryExecutor& executor, const SearchServer& search_server, const std::vector<std::string>& queries) {
+	std::vector<std::vector<Document>> result(queries.size());
+	ProcessQueryRange(executor, search_server, queries, 0, queries.size(), result.data());
 	return result;
 }
 
+void ProcessQueryRange(QueryExecutor& executor, const SearchServer& search_server, const std::vector<std::string>& queries, size_t first, size_t last, std::vector<Document>* results, const std::function<void()>& concurrent_task) {
+	const size_t query_count = last - first;
+	std::vector<size_t> costs(query_count);
+	executor.ParallelFor(query_count, [&](size_t i) {
+		costs[i] = search_server.EstimateQueryCost(queries[first + i]);
+		});
+	// Heaviest first, so a long query does not start last and hold up the whole batch.
+	std::vector<size_t> order(query_count);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&costs](size_t lhs, size_t rhs) {
+		return costs[lhs] > costs[rhs];
+		});
+
+	const size_t partition_count = executor.GetThreadCount() * PARTITIONS_PER_THREAD;
+	// The concurrent task goes first, so it starts early while the queries are spread over the workers.
+	const size_t task_offset = concurrent_task ? 1 : 0;
+	executor.ParallelFor(query_count + task_offset, [&](size_t position) {
+		if (position < task_offset) {
+			concurrent_task();
+			return;
+		}
+		const size_t i = order[position - task_offset];
+		const std::string& query = queries[first + i];
+		if (executor.GetThreadCount() == 1 || costs[i] < MIN_SPLIT_QUERY_COST) {
+			results[i] = search_server.FindTopDocuments(query);
+			return;
+		}
+		std::vector<std::vector<Document>> partition_documents(partition_count);
+		executor.ParallelFor(partition_count, [&](size_t partition) {
+			partition_documents[partition] = search_server.FindTopDocumentsInPartition(query, partition, partition_count);
+			});
+		TopDocuments top_documents(MAX_RESULT_DOCUMENT_COUNT);
+		for (const std::vector<Document>& documents : partition_documents) {
+			for (const Document& document : documents) {
+				top_documents.Add(document);
+			}
+		}
+		results[i] = top_documents.Extract();
+		});
+}
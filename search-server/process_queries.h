@@ -5,7 +5,67 @@
 #include <execution>
 
 #include "search_server.h"
+#include "query_executor.h"
+
+// Queries scanning at least this many postings are split into index partitions
+// that run as separate tasks.
+const size_t MIN_SPLIT_QUERY_COST = 64 * 1024;
+
+// Streaming variants process this many queries at a time.
+const size_t PROCESS_QUERIES_WINDOW = 4096;
+
+// Results of query i are documents[offsets[i]] .. documents[offsets[i + 1]].
+struct JoinedDocuments {
+	std::vector<size_t> offsets;
+	std::vector<Document> documents;
+};
 
 std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
 
-std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries);
\ No newline at end of file
+// Calls sink(query_index, documents) for every query, in query order. Queries
+// run PROCESS_QUERIES_WINDOW at a time into one of two window buffers that are
+// allocated once. The sink consumes a window as one more task of the next
+// window's batch, so the workers keep running queries meanwhile and at most
+// two windows of results are held. The sink runs on one thread at a time.
+template <typename QuerySink>
+void ProcessQueriesJoined(QueryExecutor& executor, const SearchServer& search_server, const std::vector<std::string>& queries, QuerySink sink);
+
+JoinedDocuments ProcessQueriesFlat(QueryExecutor& executor, const SearchServer& search_server, const std::vector<std::string>& queries);
+
+std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries);
+
+std::vector<std::vector<Document>> ProcessQueries(QueryExecutor& executor, const SearchServer& search_server, const std::vector<std::string>& queries);
+
+// Writes the results of queries[first, last) to results[0, last - first).
+// concurrent_task, if set, runs as one more task of the same batch.
+void ProcessQueryRange(QueryExecutor& executor, const SearchServer& search_server, const std::vector<std::string>& queries, size_t first, size_t last, std::vector<Document>* results, const std::function<void()>& concurrent_task = {});
+
+template <typename QuerySink>
+void ProcessQueriesJoined(QueryExecutor& executor, const SearchServer& search_server, const std::vector<std::string>& queries, QuerySink sink) {
+	const size_t window_size = std::min(queries.size(), PROCESS_QUERIES_WINDOW);
+	std::vector<std::vector<Document>> windows[2] = { std::vector<std::vector<Document>>(window_size), std::vector<std::vector<Document>>(window_size) };
+	// The window computed last, waiting for the sink.
+	size_t pending_first = 0;
+	size_t pending_last = 0;
+	const auto consume_pending = [&] {
+		const std::vector<std::vector<Document>>& window = windows[pending_first / window_size % 2];
+		for (size_t i = pending_first; i < pending_last; ++i) {
+			sink(i, window[i - pending_first]);
+		}
+	};
+	for (size_t first = 0; first < queries.size(); first += window_size) {
+		const size_t last = std::min(queries.size(), first + window_size);
+		std::vector<std::vector<Document>>& window = windows[first / window_size % 2];
+		if (pending_first == pending_last) {
+			ProcessQueryRange(executor, search_server, queries, first, last, window.data());
+		}
+		else {
+			ProcessQueryRange(executor, search_server, queries, first, last, window.data(), consume_pending);
+		}
+		pending_first = first;
+		pending_last = last;
+	}
+	if (pending_first != pending_last) {
+		consume_pending();
+	}
+}
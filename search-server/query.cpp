@@ -0,0 +1,19 @@
+#include "query.h"
+
+QueryWord ParseQueryWord(std::string_view text) {
+	bool is_minus = false;
+	if (text.empty()) {
+		throw std::out_of_range("Пропажа(?) запроса");
+	}
+	if (text[0] == '-') {
+		if (text.size() == 1) {
+			throw std::invalid_argument("Ничего после -");
+		}
+		if (text[1] == '-') {
+			throw std::invalid_argument("Больше одного - подряд");
+		}
+		is_minus = true;
+		text = text.substr(1);
+	}
+	return { text, is_minus };
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "string_processing.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+struct QueryWord {
+	std::string_view data;
+	bool is_minus;
+};
+
+struct Query {
+	std::vector<std::string_view> plus_words;
+	std::vector<std::string_view> minus_words;
+};
+
+QueryWord ParseQueryWord(std::string_view text);
+
+template <typename StopWordPredicate>
+void ParseRawQuery(std::string_view text, bool unique, StopWordPredicate is_stop_word, Query& query) {
+	query.plus_words.clear();
+	query.minus_words.clear();
+	thread_local std::vector<std::string_view> words;
+	if (!SplitIntoValidWords(text, words)) {
+		throw std::invalid_argument("Спецсимвол");
+	}
+	for (std::string_view word : words) {
+		const QueryWord query_word = ParseQueryWord(word);
+		if (!is_stop_word(query_word.data)) {
+			if (query_word.is_minus) {
+				query.minus_words.push_back(query_word.data);
+			}
+			else {
+				query.plus_words.push_back(query_word.data);
+			}
+		}
+	}
+	if (unique) {
+		std::sort(query.plus_words.begin(), query.plus_words.end());
+		auto del = std::unique(query.plus_words.begin(), query.plus_words.end());
+		query.plus_words.erase(del, query.plus_words.end());
+
+		std::sort(query.minus_words.begin(), query.minus_words.end());
+		del = std::unique(query.minus_words.begin(), query.minus_words.end());
+		query.minus_words.erase(del, query.minus_words.end());
+	}
+}
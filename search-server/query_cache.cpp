@@ -0,0 +1,115 @@
+#include "query_cache.h"
+
+#include <functional>
+
+double QueryCacheStats::GetHitRate() const {
+	const uint64_t lookups = hits + misses;
+	return lookups == 0 ? 0.0 : hits * 1.0 / lookups;
+}
+
+double QueryCacheStats::GetAverageHitLatency() const {
+	return hits == 0 ? 0.0 : hit_nanoseconds * 1.0 / hits;
+}
+
+double QueryCacheStats::GetAverageMissLatency() const {
+	return misses == 0 ? 0.0 : miss_nanoseconds * 1.0 / misses;
+}
+
+QueryCache::QueryCache(const SearchServer& search_server, size_t capacity)
+	: search_server_(search_server)
+	, shard_capacity_(std::max<size_t>(1, (capacity + QUERY_CACHE_SHARD_COUNT - 1) / QUERY_CACHE_SHARD_COUNT))
+	, shards_(QUERY_CACHE_SHARD_COUNT)
+{
+}
+
+std::vector<Document> QueryCache::FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t top_count) {
+	return FindCached(raw_query, 's', static_cast<uint64_t>(status), top_count, [&] {
+		return search_server_.FindTopDocuments(raw_query, status, top_count);
+		});
+}
+
+QueryCacheStats QueryCache::GetStats() const {
+	QueryCacheStats stats;
+	for (const Shard& shard : shards_) {
+		std::lock_guard guard(shard.mutex);
+		stats.hits += shard.hits;
+		stats.misses += shard.misses;
+		stats.invalidations += shard.invalidations;
+		stats.evictions += shard.evictions;
+		stats.entry_count += shard.entries.size();
+		stats.memory_usage += shard.memory_usage;
+	}
+	stats.hit_nanoseconds = hit_nanoseconds_.load(std::memory_order_relaxed);
+	stats.miss_nanoseconds = miss_nanoseconds_.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void QueryCache::Clear() {
+	for (Shard& shard : shards_) {
+		std::lock_guard guard(shard.mutex);
+		shard.index.clear();
+		shard.entries.clear();
+		shard.memory_usage = 0;
+	}
+}
+
+const std::string& QueryCache::MakeKey(std::string_view raw_query, char predicate_kind, uint64_t predicate_class, size_t top_count) const {
+	thread_local std::string key;
+	search_server_.NormalizeQuery(raw_query, key);
+	key += predicate_kind;
+	key.append(reinterpret_cast<const char*>(&predicate_class), sizeof(predicate_class));
+	key.append(reinterpret_cast<const char*>(&top_count), sizeof(top_count));
+	return key;
+}
+
+QueryCache::Shard& QueryCache::GetShard(std::string_view key) {
+	return shards_[std::hash<std::string_view>{}(key) % shards_.size()];
+}
+
+bool QueryCache::Lookup(std::string_view key, const IndexVersion& version, std::vector<Document>& documents) {
+	Shard& shard = GetShard(key);
+	std::lock_guard guard(shard.mutex);
+	const auto it = shard.index.find(key);
+	if (it == shard.index.end()) {
+		++shard.misses;
+		return false;
+	}
+	const auto entry = it->second;
+	if (entry->version != version) {
+		++shard.invalidations;
+		++shard.misses;
+		shard.memory_usage -= GetEntryMemoryUsage(*entry);
+		shard.index.erase(it);
+		shard.entries.erase(entry);
+		return false;
+	}
+	++shard.hits;
+	shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+	documents = entry->documents;
+	return true;
+}
+
+void QueryCache::Store(std::string_view key, const IndexVersion& version, const std::vector<Document>& documents) {
+	Shard& shard = GetShard(key);
+	std::lock_guard guard(shard.mutex);
+	// Another thread may have stored the same query while this one was searching.
+	if (shard.index.count(key) > 0) {
+		return;
+	}
+	shard.entries.push_front({ std::string(key), version, documents });
+	shard.index.emplace(shard.entries.front().key, shard.entries.begin());
+	shard.memory_usage += GetEntryMemoryUsage(shard.entries.front());
+	while (shard.entries.size() > shard_capacity_) {
+		const Entry& last = shard.entries.back();
+		shard.memory_usage -= GetEntryMemoryUsage(last);
+		shard.index.erase(last.key);
+		shard.entries.pop_back();
+		++shard.evictions;
+	}
+}
+
+size_t QueryCache::GetEntryMemoryUsage(const Entry& entry) {
+	// A list node with two links plus a hash node with its key view, iterator and next link.
+	const size_t node_overhead = sizeof(Entry) + 2 * sizeof(void*) + sizeof(std::string_view) + 3 * sizeof(void*);
+	return node_overhead + entry.key.capacity() + entry.documents.capacity() * sizeof(Document);
+}
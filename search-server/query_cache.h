@@ -0,0 +1,123 @@
+#pragma once
+#include "search_server.h"
+
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+const size_t QUERY_CACHE_SHARD_COUNT = 16;
+
+struct QueryCacheStats {
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	// Entries dropped on lookup because the index changed since they were stored.
+	uint64_t invalidations = 0;
+	uint64_t evictions = 0;
+	size_t entry_count = 0;
+	size_t memory_usage = 0;
+	uint64_t hit_nanoseconds = 0;
+	uint64_t miss_nanoseconds = 0;
+
+	double GetHitRate() const;
+
+	double GetAverageHitLatency() const;
+
+	double GetAverageMissLatency() const;
+};
+
+// Remembers FindTopDocuments results in LRU order, split into independently
+// locked shards so concurrent readers rarely contend. Entries are keyed by the
+// normalized query, the status or predicate class and top_count, and tagged
+// with the server's GetVersion() and GetCorpusStatsVersion(): any
+// AddDocument/RemoveDocument, and any change to shared corpus stats, makes every
+// older entry a miss. Like SearchServer, lookups must not overlap with writes.
+class QueryCache {
+public:
+	QueryCache(const SearchServer& search_server, size_t capacity);
+
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL, size_t top_count = MAX_RESULT_DOCUMENT_COUNT);
+
+	// predicate_class names the predicate: calls with the same class must pass
+	// predicates that accept the same documents.
+	template <typename DocumentPredicate>
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, uint64_t predicate_class, DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT);
+
+	QueryCacheStats GetStats() const;
+
+	void Clear();
+
+private:
+	struct IndexVersion {
+		uint64_t server = 0;
+		uint64_t corpus_stats = 0;
+
+		bool operator!=(const IndexVersion& other) const {
+			return server != other.server || corpus_stats != other.corpus_stats;
+		}
+	};
+
+	struct Entry {
+		std::string key;
+		IndexVersion version;
+		std::vector<Document> documents;
+	};
+
+	struct Shard {
+		mutable std::mutex mutex;
+		// Most recently used first; the index points into the list, whose nodes never move.
+		std::list<Entry> entries;
+		std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+		size_t memory_usage = 0;
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t invalidations = 0;
+		uint64_t evictions = 0;
+	};
+
+	const SearchServer& search_server_;
+	const size_t shard_capacity_;
+	std::vector<Shard> shards_;
+	std::atomic<uint64_t> hit_nanoseconds_ = 0;
+	std::atomic<uint64_t> miss_nanoseconds_ = 0;
+
+	const std::string& MakeKey(std::string_view raw_query, char predicate_kind, uint64_t predicate_class, size_t top_count) const;
+
+	Shard& GetShard(std::string_view key);
+
+	bool Lookup(std::string_view key, const IndexVersion& version, std::vector<Document>& documents);
+
+	void Store(std::string_view key, const IndexVersion& version, const std::vector<Document>& documents);
+
+	static size_t GetEntryMemoryUsage(const Entry& entry);
+
+	template <typename Find>
+	std::vector<Document> FindCached(std::string_view raw_query, char predicate_kind, uint64_t predicate_class, size_t top_count, Find find);
+};
+
+template <typename DocumentPredicate>
+std::vector<Document> QueryCache::FindTopDocuments(std::string_view raw_query, uint64_t predicate_class, DocumentPredicate document_predicate, size_t top_count) {
+	return FindCached(raw_query, 'p', predicate_class, top_count, [&] {
+		return search_server_.FindTopDocuments(raw_query, document_predicate, top_count);
+		});
+}
+
+template <typename Find>
+std::vector<Document> QueryCache::FindCached(std::string_view raw_query, char predicate_kind, uint64_t predicate_class, size_t top_count, Find find) {
+	const auto start = std::chrono::steady_clock::now();
+	const std::string& key = MakeKey(raw_query, predicate_kind, predicate_class, top_count);
+	const IndexVersion version{ search_server_.GetVersion(), search_server_.GetCorpusStatsVersion() };
+	std::vector<Document> documents;
+	const bool hit = Lookup(key, version, documents);
+	if (!hit) {
+		documents = find();
+		Store(key, version, documents);
+	}
+	const uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	(hit ? hit_nanoseconds_ : miss_nanoseconds_).fetch_add(nanoseconds, std::memory_order_relaxed);
+	return documents;
+}
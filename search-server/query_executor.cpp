@@ -0,0 +1,183 @@
+#include "query_executor.h"
+
+#include <iterator>
+
+namespace {
+
+thread_local const void* current_executor = nullptr;
+thread_local size_t current_worker = 0;
+
+}
+
+QueryExecutor::QueryExecutor(size_t thread_count) {
+	thread_count = std::max<size_t>(1, thread_count);
+	for (size_t i = 0; i < thread_count; ++i) {
+		workers_.push_back(std::make_unique<JobQueue>());
+	}
+	for (size_t i = 0; i < thread_count; ++i) {
+		threads_.emplace_back([this, i] {
+			WorkerLoop(i);
+			});
+	}
+}
+
+QueryExecutor::~QueryExecutor() {
+	{
+		std::lock_guard guard(sleep_mutex_);
+		stopping_ = true;
+	}
+	work_available_.notify_all();
+	for (std::thread& thread : threads_) {
+		thread.join();
+	}
+}
+
+size_t QueryExecutor::GetThreadCount() const {
+	return threads_.size();
+}
+
+void QueryExecutor::Run(Batch& batch, size_t task_count) {
+	batch.remaining = task_count;
+	const size_t worker = current_executor == this ? current_worker : static_cast<size_t>(NO_WORKER);
+	Push(worker, { &batch, 0, task_count });
+	while (batch.remaining.load(std::memory_order_acquire) > 0) {
+		if (TryRunJob(worker, &batch)) {
+			continue;
+		}
+		std::unique_lock lock(sleep_mutex_);
+		++sleeping_waiters_;
+		work_available_.wait(lock, [&batch] {
+			return batch.remaining.load(std::memory_order_acquire) == 0 || batch.queued > 0;
+			});
+		--sleeping_waiters_;
+	}
+	if (batch.error) {
+		std::rethrow_exception(batch.error);
+	}
+}
+
+void QueryExecutor::Push(size_t worker, const Job& job) {
+	JobQueue& queue = worker == NO_WORKER ? injected_jobs_ : *workers_[worker];
+	{
+		std::lock_guard guard(queue.mutex);
+		// Counted before it can be popped; the batch may be gone once its last job runs.
+		++job.batch->queued;
+		queue.jobs.push_back(job);
+	}
+	++queued_jobs_;
+	bool has_sleeping_waiters;
+	{
+		// Taking the lock orders this push before a sleeping thread's re-check.
+		std::lock_guard guard(sleep_mutex_);
+		has_sleeping_waiters = sleeping_waiters_ > 0;
+	}
+	if (has_sleeping_waiters) {
+		work_available_.notify_all();
+	}
+	else {
+		work_available_.notify_one();
+	}
+}
+
+bool QueryExecutor::TryPopJob(JobQueue& queue, bool newest, const Batch* batch, Job& job) {
+	std::lock_guard guard(queue.mutex);
+	if (batch == nullptr) {
+		if (queue.jobs.empty()) {
+			return false;
+		}
+		if (newest) {
+			job = queue.jobs.back();
+			queue.jobs.pop_back();
+		}
+		else {
+			job = queue.jobs.front();
+			queue.jobs.pop_front();
+		}
+		return true;
+	}
+	const auto is_batch_job = [batch](const Job& queued_job) {
+		return queued_job.batch == batch;
+	};
+	if (newest) {
+		const auto it = std::find_if(queue.jobs.rbegin(), queue.jobs.rend(), is_batch_job);
+		if (it == queue.jobs.rend()) {
+			return false;
+		}
+		job = *it;
+		queue.jobs.erase(std::next(it).base());
+	}
+	else {
+		const auto it = std::find_if(queue.jobs.begin(), queue.jobs.end(), is_batch_job);
+		if (it == queue.jobs.end()) {
+			return false;
+		}
+		job = *it;
+		queue.jobs.erase(it);
+	}
+	return true;
+}
+
+bool QueryExecutor::TryRunJob(size_t worker, const Batch* batch) {
+	Job job;
+	bool found = (worker != NO_WORKER && TryPopJob(*workers_[worker], true, batch, job)) || TryPopJob(injected_jobs_, false, batch, job);
+	const size_t first_victim = worker == NO_WORKER ? 0 : worker + 1;
+	for (size_t i = 0; !found && i < workers_.size(); ++i) {
+		const size_t victim = (first_victim + i) % workers_.size();
+		found = victim != worker && TryPopJob(*workers_[victim], false, batch, job);
+	}
+	if (!found) {
+		return false;
+	}
+	--job.batch->queued;
+	--queued_jobs_;
+	Execute(worker, job);
+	return true;
+}
+
+void QueryExecutor::Execute(size_t worker, Job job) {
+	// Leave the upper halves behind for thieves and run the first index here.
+	while (job.last - job.first > 1) {
+		const size_t middle = job.first + (job.last - job.first) / 2;
+		Push(worker, { job.batch, middle, job.last });
+		job.last = middle;
+	}
+	Batch& batch = *job.batch;
+	try {
+		batch.run(batch.task, job.first);
+	}
+	catch (...) {
+		std::lock_guard guard(batch.error_mutex);
+		if (!batch.error) {
+			batch.error = std::current_exception();
+		}
+	}
+	if (batch.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		// The batch may be gone once its waiter sees zero, so only shared state is touched here.
+		{
+			std::lock_guard guard(sleep_mutex_);
+		}
+		work_available_.notify_all();
+	}
+}
+
+void QueryExecutor::WorkerLoop(size_t worker) {
+	current_executor = this;
+	current_worker = worker;
+	while (true) {
+		if (TryRunJob(worker, nullptr)) {
+			continue;
+		}
+		std::unique_lock lock(sleep_mutex_);
+		work_available_.wait(lock, [this] {
+			return stopping_ || queued_jobs_ > 0;
+			});
+		if (stopping_ && queued_jobs_ == 0) {
+			return;
+		}
+	}
+}
+
+QueryExecutor& GetDefaultQueryExecutor() {
+	static QueryExecutor executor;
+	return executor;
+}
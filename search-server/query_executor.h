@@ -0,0 +1,100 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A persistent pool of workers, each with its own job deque. A worker takes
+// its newest job first and, when it runs out, the oldest (largest) job from
+// the injection queue or from another worker. Threads outside the pool submit
+// through the injection queue. A thread waiting in ParallelFor runs only jobs
+// of its own batch, so a nested batch is not held up by unrelated jobs the
+// waiter would otherwise pick up. Workers are long-lived, so the
+// thread_local scratch buffers used by SearchServer stay warm between batches.
+class QueryExecutor {
+public:
+	explicit QueryExecutor(size_t thread_count = std::max(1u, std::thread::hardware_concurrency()));
+
+	QueryExecutor(const QueryExecutor&) = delete;
+
+	QueryExecutor& operator=(const QueryExecutor&) = delete;
+
+	~QueryExecutor();
+
+	size_t GetThreadCount() const;
+
+	// Runs task(i) for every i in [0, task_count) and returns once all are done;
+	// the first exception thrown by a task is rethrown here. The calling thread
+	// runs jobs while it waits, so tasks may call ParallelFor themselves.
+	template <typename Task>
+	void ParallelFor(size_t task_count, const Task& task);
+
+private:
+	struct Batch {
+		void (*run)(const void* task, size_t index) = nullptr;
+		const void* task = nullptr;
+		std::atomic<size_t> remaining = 0;
+		// Jobs of this batch sitting in some queue.
+		std::atomic<size_t> queued = 0;
+		std::mutex error_mutex;
+		std::exception_ptr error;
+	};
+
+	struct Job {
+		Batch* batch;
+		size_t first;
+		size_t last;
+	};
+
+	struct JobQueue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	// Stands for a thread outside the pool.
+	static const size_t NO_WORKER = static_cast<size_t>(-1);
+
+	std::vector<std::unique_ptr<JobQueue>> workers_;
+	JobQueue injected_jobs_;
+	std::vector<std::thread> threads_;
+	std::atomic<size_t> queued_jobs_ = 0;
+	std::mutex sleep_mutex_;
+	std::condition_variable work_available_;
+	// Threads asleep in Run; pushes wake everyone while there are any, since
+	// only the batch's own waiter can take its job.
+	size_t sleeping_waiters_ = 0;
+	bool stopping_ = false;
+
+	void Run(Batch& batch, size_t task_count);
+
+	void Push(size_t worker, const Job& job);
+
+	// With a batch, takes the newest or oldest job of that batch only.
+	static bool TryPopJob(JobQueue& queue, bool newest, const Batch* batch, Job& job);
+
+	bool TryRunJob(size_t worker, const Batch* batch);
+
+	void Execute(size_t worker, Job job);
+
+	void WorkerLoop(size_t worker);
+};
+
+QueryExecutor& GetDefaultQueryExecutor();
+
+template <typename Task>
+void QueryExecutor::ParallelFor(size_t task_count, const Task& task) {
+	if (task_count == 0) {
+		return;
+	}
+	Batch batch;
+	batch.run = [](const void* task, size_t index) {
+		(*static_cast<const Task*>(task))(index);
+	};
+	batch.task = &task;
+	Run(batch, task_count);
+}
@@ -0,0 +1,174 @@
+#include "query_metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+const uint64_t SUB_BUCKET_COUNT = uint64_t{ 1 } << LATENCY_SUB_BUCKET_BITS;
+
+// Written only by its own thread; relaxed atomics let snapshots read it safely.
+struct ThreadQueryMetrics {
+	std::array<std::array<std::atomic<uint64_t>, LATENCY_BUCKET_COUNT>, QUERY_STAGE_COUNT> buckets = {};
+	std::array<std::atomic<uint64_t>, QUERY_COUNTER_COUNT> counters = {};
+};
+
+void Increase(std::atomic<uint64_t>& value, uint64_t delta) {
+	value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+struct QueryMetricsRegistry {
+	std::mutex mutex;
+	// Kept after their threads exit so nothing recorded is lost.
+	std::vector<std::unique_ptr<ThreadQueryMetrics>> threads;
+	QueryMetrics baseline;
+};
+
+QueryMetricsRegistry& GetRegistry() {
+	static QueryMetricsRegistry registry;
+	return registry;
+}
+
+ThreadQueryMetrics& GetThreadQueryMetrics() {
+	thread_local ThreadQueryMetrics* metrics = nullptr;
+	if (metrics == nullptr) {
+		QueryMetricsRegistry& registry = GetRegistry();
+		std::lock_guard guard(registry.mutex);
+		registry.threads.push_back(std::make_unique<ThreadQueryMetrics>());
+		metrics = registry.threads.back().get();
+	}
+	return *metrics;
+}
+
+QueryMetrics CollectQueryMetrics(const QueryMetricsRegistry& registry) {
+	QueryMetrics metrics;
+	for (const auto& thread : registry.threads) {
+		for (size_t stage = 0; stage < QUERY_STAGE_COUNT; ++stage) {
+			for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; ++bucket) {
+				const uint64_t count = thread->buckets[stage][bucket].load(std::memory_order_relaxed);
+				if (count > 0) {
+					metrics.stages[stage].Add(GetLatencyBucketValue(bucket), count);
+				}
+			}
+		}
+		for (size_t counter = 0; counter < QUERY_COUNTER_COUNT; ++counter) {
+			metrics.counters[counter] += thread->counters[counter].load(std::memory_order_relaxed);
+		}
+	}
+	return metrics;
+}
+
+}
+
+size_t GetLatencyBucket(uint64_t nanoseconds) {
+	if (nanoseconds < SUB_BUCKET_COUNT) {
+		return nanoseconds;
+	}
+	const int shift = 63 - __builtin_clzll(nanoseconds) - LATENCY_SUB_BUCKET_BITS;
+	return ((shift + 1) << LATENCY_SUB_BUCKET_BITS) + ((nanoseconds >> shift) - SUB_BUCKET_COUNT);
+}
+
+uint64_t GetLatencyBucketValue(size_t bucket) {
+	if (bucket < SUB_BUCKET_COUNT) {
+		return bucket;
+	}
+	const int shift = static_cast<int>(bucket >> LATENCY_SUB_BUCKET_BITS) - 1;
+	const uint64_t lowest = (SUB_BUCKET_COUNT + (bucket & (SUB_BUCKET_COUNT - 1))) << shift;
+	return lowest + ((uint64_t{ 1 } << shift) >> 1);
+}
+
+LatencyHistogram::LatencyHistogram()
+	: counts_(LATENCY_BUCKET_COUNT)
+{
+}
+
+void LatencyHistogram::Add(uint64_t nanoseconds, uint64_t count) {
+	counts_[GetLatencyBucket(nanoseconds)] += count;
+	count_ += count;
+	total_nanoseconds_ += nanoseconds * count;
+}
+
+uint64_t LatencyHistogram::GetCount() const {
+	return count_;
+}
+
+double LatencyHistogram::GetMean() const {
+	return count_ == 0 ? 0 : total_nanoseconds_ * 1.0 / count_;
+}
+
+uint64_t LatencyHistogram::GetPercentile(double fraction) const {
+	if (count_ == 0) {
+		return 0;
+	}
+	const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * count_)));
+	uint64_t seen = 0;
+	for (size_t bucket = 0; bucket < counts_.size(); ++bucket) {
+		seen += counts_[bucket];
+		if (seen >= rank) {
+			return GetLatencyBucketValue(bucket);
+		}
+	}
+	return GetLatencyBucketValue(counts_.size() - 1);
+}
+
+const LatencyHistogram& QueryMetrics::GetStage(QueryStage stage) const {
+	return stages[static_cast<size_t>(stage)];
+}
+
+uint64_t QueryMetrics::GetCounter(QueryCounter counter) const {
+	return counters[static_cast<size_t>(counter)];
+}
+
+void QueryMetrics::Subtract(const QueryMetrics& other) {
+	for (size_t stage = 0; stage < QUERY_STAGE_COUNT; ++stage) {
+		LatencyHistogram& histogram = stages[stage];
+		const LatencyHistogram& other_histogram = other.stages[stage];
+		for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; ++bucket) {
+			histogram.counts_[bucket] -= other_histogram.counts_[bucket];
+		}
+		histogram.count_ -= other_histogram.count_;
+		histogram.total_nanoseconds_ -= other_histogram.total_nanoseconds_;
+	}
+	for (size_t counter = 0; counter < QUERY_COUNTER_COUNT; ++counter) {
+		counters[counter] -= other.counters[counter];
+	}
+}
+
+std::ostream& operator<<(std::ostream& output, const QueryMetrics& metrics) {
+	static const char* const stage_names[QUERY_STAGE_COUNT] = { "parse", "posting scan", "accumulate", "minus filter", "top-k" };
+	static const char* const counter_names[QUERY_COUNTER_COUNT] = { "postings scanned", "documents matched" };
+	for (size_t stage = 0; stage < QUERY_STAGE_COUNT; ++stage) {
+		const LatencyHistogram& histogram = metrics.stages[stage];
+		output << stage_names[stage] << ": count " << histogram.GetCount() << ", mean " << histogram.GetMean()
+			<< " ns, p50 " << histogram.GetPercentile(0.5) << " ns, p99 " << histogram.GetPercentile(0.99)
+			<< " ns, p999 " << histogram.GetPercentile(0.999) << " ns" << std::endl;
+	}
+	for (size_t counter = 0; counter < QUERY_COUNTER_COUNT; ++counter) {
+		output << counter_names[counter] << ": " << metrics.counters[counter] << std::endl;
+	}
+	return output;
+}
+
+QueryMetrics GetQueryMetrics() {
+	QueryMetricsRegistry& registry = GetRegistry();
+	std::lock_guard guard(registry.mutex);
+	QueryMetrics metrics = CollectQueryMetrics(registry);
+	metrics.Subtract(registry.baseline);
+	return metrics;
+}
+
+void ResetQueryMetrics() {
+	QueryMetricsRegistry& registry = GetRegistry();
+	std::lock_guard guard(registry.mutex);
+	registry.baseline = CollectQueryMetrics(registry);
+}
+
+void RecordQueryStage(QueryStage stage, uint64_t nanoseconds) {
+	Increase(GetThreadQueryMetrics().buckets[static_cast<size_t>(stage)][GetLatencyBucket(nanoseconds)], 1);
+}
+
+void AddQueryCount(QueryCounter counter, uint64_t value) {
+	Increase(GetThreadQueryMetrics().counters[static_cast<size_t>(counter)], value);
+}
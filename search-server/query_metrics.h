@@ -0,0 +1,149 @@
+#pragma once
+#include "log_duration.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Stages of a FindTopDocuments call. MaxScore interleaves scoring, the minus
+// check and top-K updates per window and records each stage's summed time.
+enum class QueryStage {
+	PARSE,
+	// Looking up the query terms' posting lists and their IDF.
+	POSTING_SCAN,
+	ACCUMULATE,
+	// Dropping documents with minus words and collecting the rest.
+	MINUS_FILTER,
+	TOP_K,
+};
+
+const size_t QUERY_STAGE_COUNT = 5;
+
+enum class QueryCounter {
+	POSTINGS_SCANNED,
+	DOCUMENTS_MATCHED,
+};
+
+const size_t QUERY_COUNTER_COUNT = 2;
+
+// Log-linear buckets as in HdrHistogram: exact below 2^LATENCY_SUB_BUCKET_BITS
+// nanoseconds, then each power of two split into 2^LATENCY_SUB_BUCKET_BITS
+// equal buckets, which bounds the relative error by about 3%.
+const int LATENCY_SUB_BUCKET_BITS = 5;
+const size_t LATENCY_BUCKET_COUNT = (64 - LATENCY_SUB_BUCKET_BITS + 1) << LATENCY_SUB_BUCKET_BITS;
+
+size_t GetLatencyBucket(uint64_t nanoseconds);
+
+// Middle of the bucket's value range.
+uint64_t GetLatencyBucketValue(size_t bucket);
+
+class LatencyHistogram {
+public:
+	LatencyHistogram();
+
+	void Add(uint64_t nanoseconds, uint64_t count = 1);
+
+	uint64_t GetCount() const;
+
+	// Snapshots rebuild histograms from bucket midpoints, so their mean is within the buckets' error.
+	double GetMean() const;
+
+	// Smallest recorded latency not below the given fraction of all, e.g. 0.99 for p99.
+	uint64_t GetPercentile(double fraction) const;
+
+private:
+	friend struct QueryMetrics;
+
+	std::vector<uint64_t> counts_;
+	uint64_t count_ = 0;
+	uint64_t total_nanoseconds_ = 0;
+};
+
+struct QueryMetrics {
+	std::array<LatencyHistogram, QUERY_STAGE_COUNT> stages;
+	std::array<uint64_t, QUERY_COUNTER_COUNT> counters = {};
+
+	const LatencyHistogram& GetStage(QueryStage stage) const;
+
+	uint64_t GetCounter(QueryCounter counter) const;
+
+	void Subtract(const QueryMetrics& other);
+};
+
+// One line per stage with count, mean, p50/p99/p999 in nanoseconds, then the counters.
+std::ostream& operator<<(std::ostream& output, const QueryMetrics& metrics);
+
+// Sums every thread's histograms. Threads write without locks or atomic
+// read-modify-writes, so a snapshot taken during queries may miss the latest few.
+QueryMetrics GetQueryMetrics();
+
+// Later snapshots count only what is recorded after this call.
+void ResetQueryMetrics();
+
+void RecordQueryStage(QueryStage stage, uint64_t nanoseconds);
+
+void AddQueryCount(QueryCounter counter, uint64_t value);
+
+class QueryStageTimer {
+public:
+	explicit QueryStageTimer(QueryStage stage)
+		: stage_(stage) {
+	}
+
+	~QueryStageTimer() {
+		RecordQueryStage(stage_, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time_).count());
+	}
+
+private:
+	const QueryStage stage_;
+	const std::chrono::steady_clock::time_point start_time_ = std::chrono::steady_clock::now();
+};
+
+// Sums the scopes of one stage that a loop interleaves with other stages and
+// records the sum as a single sample when it goes out of scope.
+class QueryStageTotal {
+public:
+	class Scope {
+	public:
+		explicit Scope(QueryStageTotal& total)
+			: total_(total) {
+		}
+
+		~Scope() {
+			total_.nanoseconds_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time_).count();
+		}
+
+	private:
+		QueryStageTotal& total_;
+		const std::chrono::steady_clock::time_point start_time_ = std::chrono::steady_clock::now();
+	};
+
+	explicit QueryStageTotal(QueryStage stage)
+		: stage_(stage) {
+	}
+
+	~QueryStageTotal() {
+		RecordQueryStage(stage_, nanoseconds_);
+	}
+
+private:
+	const QueryStage stage_;
+	uint64_t nanoseconds_ = 0;
+};
+
+// Instrumentation is compiled in only with -DSEARCH_SERVER_METRICS; otherwise
+// the macros expand to nothing and snapshots stay empty.
+#ifdef SEARCH_SERVER_METRICS
+#define QUERY_STAGE(stage) QueryStageTimer PROFILE_CONCAT(queryStageTimer, __LINE__)(QueryStage::stage)
+#define QUERY_STAGE_TOTAL(total, stage) QueryStageTotal total(QueryStage::stage)
+#define QUERY_STAGE_SCOPE(total) QueryStageTotal::Scope PROFILE_CONCAT(queryStageScope, __LINE__)(total)
+#define QUERY_COUNT(counter, value) AddQueryCount(QueryCounter::counter, value)
+#else
+#define QUERY_STAGE(stage)
+#define QUERY_STAGE_TOTAL(total, stage)
+#define QUERY_STAGE_SCOPE(total)
+#define QUERY_COUNT(counter, value)
+#endif
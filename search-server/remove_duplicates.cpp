@@ -1,23 +1,178 @@
 #include "remove_duplicates.h"
 
-void RemoveDuplicates(SearchServer& search_server) {
-	std::set< std::set<std::string_view>> unique_set_of_words;
-	std::vector<int> id_to_delete;
-	for (auto& data : search_server) {
-		std::map<std::string_view, double> check_map = search_server.GetWordFrequencies(data);
-		std::set<std::string_view> set_of_document_words;
-		for (auto& word : check_map) {
-			set_of_document_words.insert(word.first);
-		}
-		if (unique_set_of_words.count(set_of_document_words)) {
-			id_to_delete.push_back(data);
+#include <cstring>
+
+namespace {
+
+const uint64_t LOW_SEED = 0x9e3779b97f4a7c15ULL;
+const uint64_t HIGH_SEED = 0xc2b2ae3d27d4eb4fULL;
+
+uint64_t Mix(uint64_t value) {
+	value ^= value >> 30;
+	value *= 0xbf58476d1ce4e5b9ULL;
+	value ^= value >> 27;
+	value *= 0x94d049bb133111ebULL;
+	return value ^ (value >> 31);
+}
+
+uint64_t HashWord(std::string_view word, uint64_t seed) {
+	uint64_t hash = Mix(seed ^ word.size());
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= word.size(); i += sizeof(uint64_t)) {
+		uint64_t chunk;
+		std::memcpy(&chunk, word.data() + i, sizeof(chunk));
+		hash = Mix(hash ^ chunk);
+	}
+	uint64_t tail = 0;
+	std::memcpy(&tail, word.data() + i, word.size() - i);
+	return Mix(hash ^ tail);
+}
+
+double ComputeJaccardSimilarity(const std::map<std::string_view, double>& lhs, const std::map<std::string_view, double>& rhs) {
+	size_t common_count = 0;
+	for (auto left = lhs.begin(), right = rhs.begin(); left != lhs.end() && right != rhs.end();) {
+		if (left->first < right->first) {
+			++left;
+		}
+		else if (right->first < left->first) {
+			++right;
 		}
 		else {
-			unique_set_of_words.insert(set_of_document_words);
+			++common_count;
+			++left;
+			++right;
 		}
 	}
-	for (auto id : id_to_delete) {
-		search_server.RemoveDocument(id);
-		std::cout << "Found duplicate document id " << id << std::endl;
+	const size_t union_count = lhs.size() + rhs.size() - common_count;
+	return union_count == 0 ? 1.0 : common_count * 1.0 / union_count;
+}
+
+// Rows per LSH band: the band count b and row count r make documents of
+// similarity about (1/b)^(1/r) collide in half the cases, so pick the largest
+// such value not above the threshold to favour recall; exact checks follow.
+int ChooseBandRows(double similarity_threshold) {
+	int band_rows = 1;
+	for (int rows = 2; rows <= MIN_HASH_COUNT; rows *= 2) {
+		const double band_threshold = std::pow(1.0 / (MIN_HASH_COUNT / rows), 1.0 / rows);
+		if (band_threshold <= similarity_threshold) {
+			band_rows = rows;
+		}
+	}
+	return band_rows;
+}
+
+}
+
+DocumentFingerprint ComputeFingerprint(const std::map<std::string_view, double>& word_freqs) {
+	DocumentFingerprint fingerprint{ LOW_SEED, HIGH_SEED };
+	for (const auto& [word, term_freq] : word_freqs) {
+		fingerprint.low = Mix(fingerprint.low ^ HashWord(word, LOW_SEED));
+		fingerprint.high = Mix(fingerprint.high + HashWord(word, HIGH_SEED));
+	}
+	return fingerprint;
+}
+
+std::vector<int> FindDuplicates(const SearchServer& search_server) {
+	const std::vector<int> document_ids(search_server.begin(), search_server.end());
+	std::vector<std::pair<DocumentFingerprint, int>> fingerprints(document_ids.size());
+	std::transform(std::execution::par, document_ids.begin(), document_ids.end(), fingerprints.begin(), [&search_server](int document_id) {
+		return std::pair{ ComputeFingerprint(search_server.GetWordFrequencies(document_id)), document_id };
+		});
+	// Within a group of equal fingerprints the smallest id comes first and is kept.
+	std::sort(std::execution::par, fingerprints.begin(), fingerprints.end());
+	std::vector<int> duplicates;
+	for (size_t i = 1; i < fingerprints.size(); ++i) {
+		if (fingerprints[i].first == fingerprints[i - 1].first) {
+			duplicates.push_back(fingerprints[i].second);
+		}
+	}
+	std::sort(duplicates.begin(), duplicates.end());
+	return duplicates;
+}
+
+std::vector<int> FindNearDuplicates(const SearchServer& search_server, double similarity_threshold) {
+	if (!(similarity_threshold > 0 && similarity_threshold <= 1)) {
+		throw std::invalid_argument("Порог сходства вне (0, 1]");
+	}
+	const std::vector<int> document_ids(search_server.begin(), search_server.end());
+	std::vector<uint64_t> signatures(document_ids.size() * MIN_HASH_COUNT);
+	std::vector<size_t> documents(document_ids.size());
+	std::iota(documents.begin(), documents.end(), 0);
+	std::for_each(std::execution::par, documents.begin(), documents.end(), [&](size_t document) {
+		const auto signature = signatures.begin() + document * MIN_HASH_COUNT;
+		std::fill(signature, signature + MIN_HASH_COUNT, UINT64_MAX);
+		for (const auto& [word, term_freq] : search_server.GetWordFrequencies(document_ids[document])) {
+			const uint64_t word_hash = HashWord(word, LOW_SEED);
+			for (int i = 0; i < MIN_HASH_COUNT; ++i) {
+				signature[i] = std::min(signature[i], Mix(word_hash + i * HIGH_SEED));
+			}
+		}
+		});
+
+	const int band_rows = ChooseBandRows(similarity_threshold);
+	std::unordered_map<uint64_t, std::vector<size_t>> buckets;
+	std::vector<uint64_t> bucket_keys(MIN_HASH_COUNT / band_rows);
+	std::vector<size_t> last_checked(document_ids.size(), SIZE_MAX);
+	std::vector<int> duplicates;
+	for (size_t document = 0; document < document_ids.size(); ++document) {
+		const auto signature = signatures.begin() + document * MIN_HASH_COUNT;
+		const auto& word_freqs = search_server.GetWordFrequencies(document_ids[document]);
+		bool is_duplicate = false;
+		for (size_t band = 0; band < bucket_keys.size(); ++band) {
+			uint64_t key = Mix(band);
+			for (int row = 0; row < band_rows; ++row) {
+				key = Mix(key ^ signature[band * band_rows + row]);
+			}
+			bucket_keys[band] = key;
+			const auto bucket = buckets.find(key);
+			if (is_duplicate || bucket == buckets.end()) {
+				continue;
+			}
+			for (const size_t candidate : bucket->second) {
+				if (last_checked[candidate] == document) {
+					continue;
+				}
+				last_checked[candidate] = document;
+				if (ComputeJaccardSimilarity(word_freqs, search_server.GetWordFrequencies(document_ids[candidate])) >= similarity_threshold) {
+					is_duplicate = true;
+					break;
+				}
+			}
+		}
+		if (is_duplicate) {
+			duplicates.push_back(document_ids[document]);
+			continue;
+		}
+		for (const uint64_t key : bucket_keys) {
+			buckets[key].push_back(document);
+		}
+	}
+	return duplicates;
+}
+
+std::vector<int> RemoveDuplicates(SearchServer& search_server) {
+	const std::vector<int> duplicates = FindDuplicates(search_server);
+	search_server.RemoveDocuments(std::execution::par, duplicates);
+	return duplicates;
+}
+
+std::vector<int> RemoveNearDuplicates(SearchServer& search_server, double similarity_threshold) {
+	const std::vector<int> duplicates = FindNearDuplicates(search_server, similarity_threshold);
+	search_server.RemoveDocuments(std::execution::par, duplicates);
+	return duplicates;
+}
+
+std::optional<int> DuplicateIndex::Add(const SearchServer& search_server, int document_id) {
+	const auto [it, inserted] = documents_.emplace(ComputeFingerprint(search_server.GetWordFrequencies(document_id)), document_id);
+	if (inserted) {
+		return std::nullopt;
+	}
+	return it->second;
+}
+
+void DuplicateIndex::Remove(const SearchServer& search_server, int document_id) {
+	const auto it = documents_.find(ComputeFingerprint(search_server.GetWordFrequencies(document_id)));
+	if (it != documents_.end() && it->second == document_id) {
+		documents_.erase(it);
 	}
-}
\ No newline at end of file
+}
@@ -1,4 +1,56 @@
 #pragma once
 #include "search_server.h"
 
-void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
+#include <optional>
+#include <unordered_map>
+
+const int MIN_HASH_COUNT = 64;
+
+// A 128-bit hash of a document's sorted word set: equal sets give equal
+// fingerprints, and distinct sets collide with negligible probability.
+struct DocumentFingerprint {
+	uint64_t low = 0;
+	uint64_t high = 0;
+
+	bool operator==(const DocumentFingerprint& other) const {
+		return low == other.low && high == other.high;
+	}
+
+	bool operator<(const DocumentFingerprint& other) const {
+		return low < other.low || (low == other.low && high < other.high);
+	}
+};
+
+DocumentFingerprint ComputeFingerprint(const std::map<std::string_view, double>& word_freqs);
+
+// Ids of documents whose word set equals that of a document with a smaller id.
+std::vector<int> FindDuplicates(const SearchServer& search_server);
+
+// Ids of documents whose words have Jaccard similarity of at least
+// similarity_threshold with a kept document of smaller id. Candidates come from
+// MinHash signatures bucketed by LSH bands and are confirmed on the exact word sets.
+std::vector<int> FindNearDuplicates(const SearchServer& search_server, double similarity_threshold);
+
+// Removes what FindDuplicates finds and returns the removed ids; printing them is up to the caller.
+std::vector<int> RemoveDuplicates(SearchServer& search_server);
+
+std::vector<int> RemoveNearDuplicates(SearchServer& search_server, double similarity_threshold);
+
+// Fingerprints of documents added so far, for checking each new document right
+// after AddDocument instead of rescanning the whole server.
+class DuplicateIndex {
+public:
+	// Returns the id of an earlier document with the same words, or records document_id.
+	std::optional<int> Add(const SearchServer& search_server, int document_id);
+
+	void Remove(const SearchServer& search_server, int document_id);
+
+private:
+	struct FingerprintHash {
+		size_t operator()(const DocumentFingerprint& fingerprint) const {
+			return fingerprint.low;
+		}
+	};
+
+	std::unordered_map<DocumentFingerprint, int, FingerprintHash> documents_;
+};
@@ -1,8 +1,6 @@
 #include "search_server.h"
+#include "index_snapshot.h"
 
-#include <numeric>
-
-const int QUERY_VECTOR_COUNT = 500;
 
 SearchServer::SearchServer(const std::string& stop_words_text)
 	: SearchServer(SplitIntoWords(stop_words_text))
@@ -14,6 +12,21 @@ SearchServer::SearchServer(std::string_view stop_words_text)
 {
 }
 
+SearchServer::SearchServer(const SearchServer& other)
+	: stop_words_(other.stop_words_)
+	, index_(other.index_)
+	, id_to_word_freqs_(other.id_to_word_freqs_)
+	, documents_(other.documents_)
+	, ordinal_documents_(other.ordinal_documents_)
+	, status_bitmaps_(other.status_bitmaps_)
+	, document_ids_(other.document_ids_)
+	, query_evaluation_(other.query_evaluation_)
+	, version_(other.version_)
+	, corpus_stats_(other.corpus_stats_)
+{
+	RebindWordFrequencies();
+}
+
 void SearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
 	if (document_id < 0) {
 		throw std::invalid_argument("Отрицательный идентификатор");
@@ -21,25 +34,44 @@ void SearchServer::AddDocument(int document_id, std::string_view document, Docum
 	if (document_ids_.count(document_id) == 1) {
 		throw std::invalid_argument("Идентификатор используется");
 	}
-	if (!IsValidWord((std::string)document)) {
+	thread_local std::vector<std::string_view> words;
+	if (!SplitIntoValidWords(document, words)) {
 		throw std::invalid_argument("Спецсимвол");
 	}
-	const std::vector<std::string> words = SplitIntoWordsNoStop((std::string)document);
-	const double inv_word_count = 1.0 / words.size();
-	for (const std::string& word : words) {
-		auto some_pair = set_of_string_.insert(word);
-		word_to_document_freqs_[*some_pair.first][document_id] += inv_word_count;
-		id_to_word_freqs_[document_id][*some_pair.first] += inv_word_count;
+	thread_local std::vector<int> term_ids;
+	term_ids.clear();
+	for (std::string_view word : words) {
+		if (!IsStopWord(word)) {
+			term_ids.push_back(index_.AddTerm(word));
+		}
+	}
+	const double inv_word_count = 1.0 / term_ids.size();
+	const int document_ordinal = static_cast<int>(ordinal_documents_.size());
+	std::sort(term_ids.begin(), term_ids.end());
+	if (!term_ids.empty()) {
+		auto& word_freqs = id_to_word_freqs_[document_id];
+		for (auto first = term_ids.begin(); first != term_ids.end();) {
+			const auto last = std::upper_bound(first, term_ids.end(), *first);
+			const double term_freq = (last - first) * inv_word_count;
+			index_.AddPosting(*first, document_ordinal, term_freq);
+			word_freqs.emplace(index_.GetTerm(*first), term_freq);
+			first = last;
+		}
 	}
-	documents_.insert({ document_id, DocumentData{ ComputeAverageRating(ratings), status } });
+	documents_.insert({ document_id, DocumentData{ document_ordinal, static_cast<int>(term_ids.size()) } });
+	ordinal_documents_.push_back({ document_id, ComputeAverageRating(ratings), status });
+	SetStatusBit(status, document_ordinal, true);
 	document_ids_.insert(document_id);
+	++version_;
 	return;
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
-	return SearchServer::FindTopDocuments(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-		return document_status == status;
-		});
+void SearchServer::AddDocuments(const std::vector<RawDocument>& documents) {
+	AddDocuments(std::execution::seq, documents);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t top_count) const {
+	return SearchServer::FindTopDocuments(raw_query, DocumentStatusFilter{ status }, top_count);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const {
@@ -50,33 +82,59 @@ int SearchServer::GetDocumentCount() const {
 	return document_ids_.size();
 }
 
+size_t SearchServer::EstimateQueryCost(std::string_view raw_query) const {
+	const Query& query = ParseQuery(raw_query, true);
+	size_t cost = 0;
+	for (const auto& words : { &query.plus_words, &query.minus_words }) {
+		for (std::string_view word : *words) {
+			const int term_id = index_.GetTermId(word);
+			if (term_id != InvertedIndex::NO_TERM) {
+				cost += index_.GetPostings(term_id).size();
+			}
+		}
+	}
+	return cost;
+}
+
+std::vector<Document> SearchServer::FindTopDocumentsInPartition(std::string_view raw_query, size_t partition, size_t partition_count, size_t top_count) const {
+	const QueryPostings query_postings = GetQueryPostings(ParseQuery(raw_query, true), corpus_stats_);
+	const size_t ordinal_count = ordinal_documents_.size();
+	const size_t partition_size = (ordinal_count + partition_count - 1) / partition_count;
+	const size_t first_ordinal = std::min(ordinal_count, partition * partition_size);
+	const size_t last_ordinal = std::min(ordinal_count, first_ordinal + partition_size);
+	std::vector<Document> matched_documents;
+	FindPartitionDocuments(query_postings, static_cast<int>(first_ordinal), static_cast<int>(last_ordinal), DocumentStatusFilter{ DocumentStatus::ACTUAL }, matched_documents);
+	return SelectTopDocuments(matched_documents, top_count);
+}
+
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
-	//LOG_DURATION_STREAM((std::string)"MD", std::cerr);
 	if (!IsValidWord(raw_query)) {
 		throw std::invalid_argument("Спецсимвол");
 	}
 	if (document_ids_.count(document_id) == 0) {
 		throw std::out_of_range("Нет ID");
 	}
-	const Query query = ParseQuery(raw_query,true);
+	const Query& query = ParseQuery(raw_query,true);
+	const std::map<std::string_view, double>& word_freqs = GetWordFrequencies(document_id);
 	std::vector<std::string_view> matched_words;
 	for (std::string_view word : query.minus_words) {
-		if (id_to_word_freqs_.at(document_id).count(word) == 0) {
+		if (word_freqs.count(word) == 0) {
 			continue;
 		}
 		else {
-			return { matched_words, documents_.at(document_id).status };
+			return { matched_words, ordinal_documents_[documents_.at(document_id).ordinal].status };
 		}
 	}
 	for (std::string_view word : query.plus_words) {
-		if (id_to_word_freqs_.at(document_id).count(word) == 0) {
+		const auto it = word_freqs.find(word);
+		if (it == word_freqs.end()) {
 			continue;
 		}
 		else {
-			matched_words.push_back(*set_of_string_.find((std::string)word));
+			matched_words.push_back(it->first);
 		}
 	}
-	return { matched_words, documents_.at(document_id).status };
+	return { matched_words, ordinal_documents_[documents_.at(document_id).ordinal].status };
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::sequenced_policy, std::string_view raw_query, int document_id) const {
@@ -84,151 +142,379 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::parallel_policy, std::string_view raw_query, int document_id) const {
-	//LOG_DURATION_STREAM((std::string)"MD", std::cerr);
-	//auto test = LogDuration("");
 	if (document_ids_.count(document_id) == 0) {
 		throw std::out_of_range("Нет ID");
 	}
 	const Query query = ParseQuery(std::execution::par, raw_query, true);
+	const std::map<std::string_view, double>& word_freqs = GetWordFrequencies(document_id);
 	std::vector<std::string_view> matched_words;
 	if (!none_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(), [&](auto& word) {
-		return id_to_word_freqs_.at(document_id).count(word);
+		return word_freqs.count(word);
 		})) {
-		return { matched_words, documents_.at(document_id).status };
+		return { matched_words, ordinal_documents_[documents_.at(document_id).ordinal].status };
 	};
 
 	matched_words.resize(query.plus_words.size());
 	auto del = std::copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), [&](auto& word) {
-		return id_to_word_freqs_.at(document_id).count(word);
+		return word_freqs.count(word);
 		});
 	matched_words.erase(del, matched_words.end());
+	std::transform(std::execution::par, matched_words.begin(), matched_words.end(), matched_words.begin(), [&](std::string_view word) {
+		return word_freqs.find(word)->first;
+		});
 
-	return { matched_words, documents_.at(document_id).status };
+	return { matched_words, ordinal_documents_[documents_.at(document_id).ordinal].status };
+}
+
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(std::string_view raw_query, const std::vector<int>& document_ids) const {
+	return MatchDocuments(std::execution::seq, raw_query, document_ids);
 }
 
 const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-	if (id_to_word_freqs_.at(document_id).empty()) {
-		static std::map<std::string_view, double> empty_string_double_map;
+	if (document_ids_.count(document_id) == 0) {
+		throw std::out_of_range("Нет ID");
+	}
+	const auto it = id_to_word_freqs_.find(document_id);
+	if (it == id_to_word_freqs_.end()) {
+		static const std::map<std::string_view, double> empty_string_double_map;
 		return empty_string_double_map;
 	}
-	return id_to_word_freqs_.at(document_id);
+	return it->second;
+}
+
+bool SearchServer::HasDocument(int document_id) const {
+	return document_ids_.count(document_id) == 1;
 }
 
 void SearchServer::RemoveDocument(int document_id) {
 	RemoveDocument(std::execution::seq, document_id);
 }
 
-bool SearchServer::IsValidWord(std::string_view word) const {
-	return IsValidWord(std::execution::seq, word);
+void SearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+	RemoveDocuments(std::execution::seq, document_ids);
 }
 
-bool SearchServer::IsStopWord(const std::string& word) const {
-	return stop_words_.count(word) > 0;
+void SearchServer::TokenizeBatchShard(const std::vector<RawDocument>& documents, DocumentBatchShard& shard) const {
+	std::vector<int> local_term_ids;
+	shard.document_term_ends.push_back(0);
+	for (size_t i = shard.first_document; i < shard.last_document; ++i) {
+		local_term_ids.clear();
+		shard.is_valid = ForEachValidWord(documents[i].text, [&](std::string_view word) {
+			if (IsStopWord(word)) {
+				return;
+			}
+			const auto [it, inserted] = shard.term_ids.emplace(word, static_cast<int>(shard.terms.size()));
+			if (inserted) {
+				shard.terms.push_back(word);
+				shard.term_document_counts.push_back(0);
+				shard.max_term_freqs.push_back(0);
+			}
+			local_term_ids.push_back(it->second);
+			});
+		if (!shard.is_valid) {
+			return;
+		}
+		const double inv_word_count = 1.0 / local_term_ids.size();
+		shard.document_word_counts.push_back(static_cast<int>(local_term_ids.size()));
+		std::sort(local_term_ids.begin(), local_term_ids.end());
+		for (auto first = local_term_ids.begin(); first != local_term_ids.end();) {
+			const auto last = std::upper_bound(first, local_term_ids.end(), *first);
+			const double term_freq = (last - first) * inv_word_count;
+			shard.document_terms.push_back({ *first, term_freq });
+			++shard.term_document_counts[*first];
+			shard.max_term_freqs[*first] = std::max(shard.max_term_freqs[*first], term_freq);
+			first = last;
+		}
+		shard.document_term_ends.push_back(shard.document_terms.size());
+	}
 }
 
-std::vector<std::string> SearchServer::SplitIntoWordsNoStop(const std::string& text) const {
-	std::vector<std::string> words;
-	for (const std::string& word : SplitIntoWords(text)) {
-		if (!IsStopWord(word)) {
-			words.push_back(word);
+void SearchServer::CompactTerms() {
+	// Old word bytes stay readable until retired_arena goes out of scope.
+	const TermDictionary::Arena retired_arena = index_.CompactTerms();
+	RebindWordFrequencies();
+}
+
+void SearchServer::RebindWordFrequencies() {
+	for (auto& [document_id, word_freqs] : id_to_word_freqs_) {
+		std::map<std::string_view, double> rebound_word_freqs;
+		for (const auto& [word, term_freq] : word_freqs) {
+			rebound_word_freqs.emplace_hint(rebound_word_freqs.end(), index_.GetTerm(index_.GetTermId(word)), term_freq);
 		}
+		word_freqs = std::move(rebound_word_freqs);
 	}
-	return words;
 }
 
-int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) const {
-	if (ratings.empty()) {
-		return 0;
-	}
-	int rating_sum = std::accumulate(ratings.begin(), ratings.end(), 0);
-	return rating_sum / static_cast<int>(ratings.size());
+bool SearchServer::NeedsOrdinalCompaction() const {
+	const size_t dead_ordinals = ordinal_documents_.size() - documents_.size();
+	return dead_ordinals >= MIN_DEAD_ORDINALS_TO_COMPACT && dead_ordinals > documents_.size();
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
-	bool is_minus = false;
-	if (text.empty()) {
-		throw std::out_of_range("Пропажа(?) запроса");
+void SearchServer::CompactOrdinals() {
+	// Live documents keep their relative order, so the remap keeps posting lists sorted.
+	std::vector<int> new_ordinals(ordinal_documents_.size(), -1);
+	for (const auto& [document_id, document_data] : documents_) {
+		new_ordinals[document_data.ordinal] = 0;
 	}
-	if (text[0] == '-') {
-		if (text.size() == 1) {
-			throw std::invalid_argument("Ничего после -");
+	std::vector<OrdinalDocument> compacted_documents;
+	compacted_documents.reserve(documents_.size());
+	for (size_t ordinal = 0; ordinal < ordinal_documents_.size(); ++ordinal) {
+		if (new_ordinals[ordinal] == 0) {
+			new_ordinals[ordinal] = static_cast<int>(compacted_documents.size());
+			compacted_documents.push_back(ordinal_documents_[ordinal]);
 		}
-		if (text[1] == '-') {
-			throw std::invalid_argument("Больше одного - подряд");
-		}
-		is_minus = true;
-		text = text.substr(1);
 	}
-	return { (std::string)text, is_minus, IsStopWord((std::string)text) };
+	index_.RemapOrdinals(new_ordinals);
+	for (auto& [document_id, document_data] : documents_) {
+		document_data.ordinal = new_ordinals[document_data.ordinal];
+	}
+	ordinal_documents_ = std::move(compacted_documents);
+	for (std::vector<uint64_t>& bitmap : status_bitmaps_) {
+		bitmap.assign((ordinal_documents_.size() + 63) / 64, 0);
+	}
+	for (size_t ordinal = 0; ordinal < ordinal_documents_.size(); ++ordinal) {
+		SetStatusBit(ordinal_documents_[ordinal].status, static_cast<int>(ordinal), true);
+	}
 }
 
-SearchServer::Query SearchServer::ParseQuery(std::string_view text,bool unique=false) const {
-	Query query;
-	if (!IsValidWord(text)) {
-		throw std::invalid_argument("Спецсимвол");
+IndexStats SearchServer::GetIndexStats() const {
+	return index_.GetStats();
+}
+
+void SearchServer::SetQueryEvaluation(QueryEvaluation query_evaluation) {
+	query_evaluation_ = query_evaluation;
+}
+
+void SearchServer::SetCorpusStats(const CorpusStats* corpus_stats) {
+	corpus_stats_ = corpus_stats;
+	++version_;
+}
+
+uint64_t SearchServer::GetVersion() const {
+	return version_;
+}
+
+uint64_t SearchServer::GetCorpusStatsVersion() const {
+	return corpus_stats_ != nullptr ? corpus_stats_->GetVersion() : 0;
+}
+
+void SearchServer::NormalizeQuery(std::string_view raw_query, std::string& normalized_query) const {
+	const Query& query = ParseQuery(raw_query, true);
+	normalized_query.clear();
+	for (std::string_view word : query.plus_words) {
+		normalized_query += word;
+		normalized_query += ' ';
+	}
+	// Words never contain control characters, so this separates the two lists.
+	normalized_query += '\x01';
+	for (std::string_view word : query.minus_words) {
+		normalized_query += word;
+		normalized_query += ' ';
+	}
+}
+
+void SearchServer::SaveSnapshot(const std::string& path, PostingFormat posting_format) const {
+	SnapshotData data;
+	data.posting_format = posting_format;
+	data.stop_words.assign(stop_words_.begin(), stop_words_.end());
+
+	std::vector<int> snapshot_ordinals(ordinal_documents_.size(), -1);
+	for (const auto& [document_id, document_data] : documents_) {
+		snapshot_ordinals[document_data.ordinal] = static_cast<int>(data.document_ids.size());
+		data.document_ids.push_back(document_id);
+		data.document_ratings.push_back(ordinal_documents_[document_data.ordinal].rating);
+		data.document_statuses.push_back(static_cast<int32_t>(ordinal_documents_[document_data.ordinal].status));
+		data.document_lengths.push_back(static_cast<uint32_t>(document_data.word_count));
+	}
+
+	std::vector<int> term_ids;
+	for (size_t term_id = 0; term_id < index_.GetTermIdBound(); ++term_id) {
+		if (!index_.GetTerm(term_id).empty()) {
+			term_ids.push_back(static_cast<int>(term_id));
+		}
+	}
+	std::sort(term_ids.begin(), term_ids.end(), [this](int lhs, int rhs) {
+		return index_.GetTerm(lhs) < index_.GetTerm(rhs);
+		});
+	std::vector<std::pair<int, double>> postings;
+	data.term_posting_bounds.push_back(0);
+	if (posting_format == PostingFormat::COMPRESSED) {
+		data.term_posting_byte_bounds.push_back(0);
 	}
-	query.plus_words.reserve(QUERY_VECTOR_COUNT);
-	query.minus_words.reserve(QUERY_VECTOR_COUNT);
-	for (std::string_view word : SplitIntoWordsView(text)) {
-		const QueryWord query_word = ParseQueryWord(word);
-		if (!query_word.is_stop) {
-			if (query_word.is_minus) {
-				query.minus_words.push_back(query_word.data);
+	for (const int term_id : term_ids) {
+		const InvertedIndex::PostingList& posting_list = index_.GetPostings(term_id);
+		postings.clear();
+		for (size_t i = 0; i < posting_list.size(); ++i) {
+			postings.push_back({ snapshot_ordinals[posting_list.document_ordinals[i]], posting_list.term_freqs[i] });
+		}
+		std::sort(postings.begin(), postings.end());
+		if (posting_format == PostingFormat::COMPRESSED) {
+			int previous_ordinal = 0;
+			for (const auto& [ordinal, term_freq] : postings) {
+				const uint32_t document_length = data.document_lengths[ordinal];
+				EncodePosting(ordinal - previous_ordinal, static_cast<uint32_t>(std::lround(term_freq * document_length)), data.posting_bytes);
+				previous_ordinal = ordinal;
 			}
-			else {
-				query.plus_words.push_back(query_word.data);
+			data.term_posting_byte_bounds.push_back(data.posting_bytes.size());
+		}
+		else {
+			for (const auto& [ordinal, term_freq] : postings) {
+				data.posting_ordinals.push_back(ordinal);
+				data.posting_term_freqs.push_back(term_freq);
 			}
 		}
+		data.terms.push_back(index_.GetTerm(term_id));
+		data.term_posting_bounds.push_back(data.term_posting_bounds.back() + postings.size());
+		data.term_max_freqs.push_back(posting_list.max_term_freq);
 	}
-	if (unique) {
-		std::sort(std::execution::seq, query.plus_words.begin(), query.plus_words.end());
-		auto del = std::unique(std::execution::seq, query.plus_words.begin(), query.plus_words.end());
-		query.plus_words.erase(del, query.plus_words.end());
 
-		std::sort(std::execution::seq, query.minus_words.begin(), query.minus_words.end());
-		del = std::unique(std::execution::seq, query.minus_words.begin(), query.minus_words.end());
-		query.minus_words.erase(del, query.minus_words.end());
+	data.document_term_bounds.push_back(0);
+	for (const int document_id : data.document_ids) {
+		const auto it = id_to_word_freqs_.find(document_id);
+		if (it != id_to_word_freqs_.end()) {
+			for (const auto& [word, _] : it->second) {
+				data.document_terms.push_back(static_cast<int32_t>(std::lower_bound(data.terms.begin(), data.terms.end(), word) - data.terms.begin()));
+			}
+		}
+		data.document_term_bounds.push_back(data.document_terms.size());
 	}
+	WriteSnapshot(data, path);
+}
+
+bool SearchServer::IsValidWord(std::string_view word) const {
+	return IsValidText(word);
+}
+
+bool SearchServer::IsStopWord(std::string_view word) const {
+	return stop_words_.count(word) > 0;
+}
+
+const Query& SearchServer::ParseQuery(std::string_view text, bool unique) const {
+	QUERY_STAGE(PARSE);
+	thread_local Query query;
+	ParseRawQuery(text, unique, [this](std::string_view word) {
+		return IsStopWord(word);
+		}, query);
 	return query;
 }
 
-SearchServer::Query SearchServer::ParseQuery(std::execution::sequenced_policy,std::string_view text,bool unique = false) const {
-	return ParseQuery(text,unique);
+const Query& SearchServer::ParseQuery(std::execution::sequenced_policy, std::string_view text, bool unique) const {
+	return ParseQuery(text, unique);
 }
 
-SearchServer::Query SearchServer::ParseQuery(std::execution::parallel_policy,std::string_view text,bool unique = false) const {
-	Query query;
-	if (!IsValidWord(std::execution::par,text)) {
-		throw std::invalid_argument("Спецсимвол");
+const Query& SearchServer::ParseQuery(std::execution::parallel_policy, std::string_view text, bool unique) const {
+	return ParseQuery(text, unique);
+}
+
+SearchServer::QueryPostings SearchServer::GetQueryPostings(const Query& query, const CorpusStats* corpus_stats) const {
+	QUERY_STAGE(POSTING_SCAN);
+	QueryPostings query_postings;
+	for (std::string_view word : query.plus_words) {
+		const int term_id = index_.GetTermId(word);
+		if (term_id != InvertedIndex::NO_TERM && !index_.GetPostings(term_id).empty()) {
+			const InvertedIndex::PostingList& postings = index_.GetPostings(term_id);
+			query_postings.plus_postings.push_back({ &postings, ComputeWordInverseDocumentFreq(word, postings, corpus_stats) });
+		}
+	}
+	for (std::string_view word : query.minus_words) {
+		const int term_id = index_.GetTermId(word);
+		if (term_id != InvertedIndex::NO_TERM) {
+			query_postings.minus_postings.push_back(&index_.GetPostings(term_id));
+		}
 	}
-	query.plus_words.reserve(QUERY_VECTOR_COUNT);
-	query.minus_words.reserve(QUERY_VECTOR_COUNT);
-	for (std::string_view word : SplitIntoWordsView(text)) {
-		const QueryWord query_word = ParseQueryWord(word);
-		if (!query_word.is_stop) {
-			if (query_word.is_minus) {
-				query.minus_words.push_back(query_word.data);
+	return query_postings;
+}
+
+SearchServer::MatchTerms SearchServer::GetMatchTerms(std::string_view raw_query, const std::vector<int>& document_ids) const {
+	const Query& query = ParseQuery(raw_query, true);
+	for (const int document_id : document_ids) {
+		if (document_ids_.count(document_id) == 0) {
+			throw std::out_of_range("Нет ID");
+		}
+	}
+	MatchTerms terms;
+	// Words sort the same way as their interned copies, so both lists stay sorted.
+	for (std::string_view word : query.plus_words) {
+		const int term_id = index_.GetTermId(word);
+		if (term_id != InvertedIndex::NO_TERM) {
+			terms.plus_terms.push_back(index_.GetTerm(term_id));
+		}
+	}
+	for (std::string_view word : query.minus_words) {
+		const int term_id = index_.GetTermId(word);
+		if (term_id != InvertedIndex::NO_TERM) {
+			terms.minus_terms.push_back(index_.GetTerm(term_id));
+		}
+	}
+	return terms;
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchTermsInDocument(const MatchTerms& terms, int document_id) const {
+	const DocumentStatus status = ordinal_documents_[documents_.at(document_id).ordinal].status;
+	const auto it = id_to_word_freqs_.find(document_id);
+	if (it == id_to_word_freqs_.end()) {
+		return { std::vector<std::string_view>(), status };
+	}
+	const std::map<std::string_view, double>& word_freqs = it->second;
+	// Sorted terms against the sorted words: each search starts past the last
+	// hit's key, and once the words run out no later term can match.
+	const auto intersect = [&word_freqs](const std::vector<std::string_view>& sorted_terms, auto on_match) {
+		auto word = word_freqs.begin();
+		for (std::string_view term : sorted_terms) {
+			if (word == word_freqs.end() || std::prev(word_freqs.end())->first < term) {
+				return;
+			}
+			if (word->first < term) {
+				word = word_freqs.lower_bound(term);
 			}
-			else {
-				query.plus_words.push_back(query_word.data);
+			if (word->first == term) {
+				if (!on_match(word->first)) {
+					return;
+				}
+				++word;
 			}
 		}
-	}
-	if (unique) {
-		auto future1 = std::async([&query]() {
-			std::sort(std::execution::par, query.plus_words.begin(), query.plus_words.end());
-			auto del = std::unique(std::execution::par, query.plus_words.begin(), query.plus_words.end());
-			query.plus_words.erase(del, query.plus_words.end());
+	};
+	bool has_minus_word = false;
+	intersect(terms.minus_terms, [&has_minus_word](std::string_view) {
+		has_minus_word = true;
+		return false;
+		});
+	std::vector<std::string_view> matched_words;
+	if (!has_minus_word) {
+		intersect(terms.plus_terms, [&matched_words](std::string_view word) {
+			matched_words.push_back(word);
+			return true;
 			});
-		std::sort(std::execution::par, query.minus_words.begin(), query.minus_words.end());
-		auto del = std::unique(std::execution::par, query.minus_words.begin(), query.minus_words.end());
-		query.minus_words.erase(del, query.minus_words.end());
-		future1.wait();
-		future1.get();
 	}
-	return query;
+	return { matched_words, status };
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(std::string_view word, const InvertedIndex::PostingList& postings, const CorpusStats* corpus_stats) const {
+	if (corpus_stats != nullptr) {
+		if (const std::optional<double> inverse_document_freq = corpus_stats->FindInverseDocumentFreq(word)) {
+			return *inverse_document_freq;
+		}
+	}
+	return postings.GetInverseDocumentFreq(GetDocumentCount());
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(std::string_view word) const {
-	return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+void SearchServer::SetStatusBit(DocumentStatus status, int document_ordinal, bool value) {
+	std::vector<uint64_t>& bitmap = status_bitmaps_[static_cast<size_t>(status)];
+	const size_t word = static_cast<size_t>(document_ordinal) / 64;
+	if (word >= bitmap.size()) {
+		for (std::vector<uint64_t>& status_bitmap : status_bitmaps_) {
+			status_bitmap.resize(std::max(word + 1, 2 * status_bitmap.size()));
+		}
+	}
+	const uint64_t mask = uint64_t{ 1 } << (document_ordinal % 64);
+	bitmap[word] = value ? bitmap[word] | mask : bitmap[word] & ~mask;
+}
+
+std::vector<double>& SearchServer::GetRelevanceScratch(size_t size) {
+	thread_local std::vector<double> relevance;
+	if (relevance.size() < size) {
+		relevance.resize(size, RELEVANCE_NOT_MATCHED);
+	}
+	return relevance;
 }
\ No newline at end of file
@@ -2,9 +2,15 @@
 #include "document.h"
 #include "string_processing.h"
 #include "log_duration.h"
-#include "concurrent_map.h"
+#include "inverted_index.h"
+#include "top_documents.h"
+#include "query.h"
+#include "posting_codec.h"
+#include "corpus_stats.h"
+#include "query_metrics.h"
 
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <iostream>
 #include <map>
@@ -16,11 +22,36 @@
 #include <queue>
 #include <execution>
 #include <iterator>
+#include <limits>
 #include <future>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
-const double RELEVANCE_ROUNDING = 1e-6;
-const size_t CONCURRENT_MAP_PARTS = 10;
+const int MIN_ORDINALS_PER_PARTITION = 4096;
+const int PARTITIONS_PER_THREAD = 4;
+// Ordinals MaxScore scores at a time before raising its threshold.
+const int MAX_SCORE_WINDOW = 4096;
+const double RELEVANCE_NOT_MATCHED = -1.0;
+const double RELEVANCE_EXCLUDED = -2.0;
+const size_t MIN_DOCUMENTS_PER_BATCH_SHARD = 256;
+const size_t MIN_PARALLEL_MATCH_DOCUMENTS = 256;
+// Removed documents' ordinals are renumbered away once there are at least this
+// many of them and they outnumber the live ones.
+const size_t MIN_DEAD_ORDINALS_TO_COMPACT = 1024;
+
+// EXHAUSTIVE scores every posting of the query's plus-words and is the default.
+// MAX_SCORE is experimental: it skips documents whose score bound cannot reach
+// the top, which pays off only when term weights differ widely. With Zipf(1)
+// document words it halves the time of queries that share that skew, but
+// elsewhere it runs up to twice as long as EXHAUSTIVE, since the bounds rarely
+// prune and it pays for sorting candidates and seeking non-essential postings.
+// SetQueryEvaluation picks it per server.
+enum class QueryEvaluation {
+	EXHAUSTIVE,
+	MAX_SCORE,
+};
 
 class SearchServer {
 public:
@@ -31,32 +62,64 @@ public:
 	template <typename StringContainer>
 	explicit SearchServer(const StringContainer& stop_words);
 
+	// A deep copy: the terms move to the copy's own dictionary, so it outlives
+	// the original. It shares the original's CorpusStats, if any.
+	SearchServer(const SearchServer& other);
+
+	SearchServer& operator=(const SearchServer&) = delete;
+
 	void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+	template<class ExecutionPolicy>
+	void AddDocuments(ExecutionPolicy&& policy, const std::vector<RawDocument>& documents);
+
+	void AddDocuments(const std::vector<RawDocument>& documents);
+
 	template <typename DocumentPredicate>
-	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
-	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
 	std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
+	// Scores this one query with the IDF of corpus_stats, e.g. stats sent along
+	// with it; unlike SetCorpusStats, leaves the server and its version as they are.
+	// Words the stats do not count are scored with this server's own IDF.
+	template <typename DocumentPredicate>
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t top_count, const CorpusStats& corpus_stats) const;
+
 	template <typename DocumentPredicate, class ExecutionPolicy>
-	std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+	std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
 	template<class ExecutionPolicy>
-	std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const;
+	std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
 	template<class ExecutionPolicy>
 	std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const;
 
 	int GetDocumentCount() const;
 
+	// Number of postings the query has to scan.
+	size_t EstimateQueryCost(std::string_view raw_query) const;
+
+	// Top documents with ACTUAL status among the partition-th of partition_count
+	// equal slices of the index; merging the slices gives FindTopDocuments(raw_query).
+	std::vector<Document> FindTopDocumentsInPartition(std::string_view raw_query, size_t partition, size_t partition_count, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
 	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
 
 	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::sequenced_policy, std::string_view raw_query, int document_id) const;
 
 	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy, std::string_view raw_query, int document_id) const;
 
+	// MatchDocument for each of document_ids, in that order, parsing the query
+	// once. Throws before matching anything if an id is unknown. Under par,
+	// batches of MIN_PARALLEL_MATCH_DOCUMENTS or more are split across threads.
+	std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+	template<class ExecutionPolicy>
+	std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(ExecutionPolicy&& policy, std::string_view raw_query, const std::vector<int>& document_ids) const;
+
 	auto begin() const {
 		return document_ids_.begin();
 	};
@@ -67,60 +130,144 @@ public:
 
 	const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
 
+	bool HasDocument(int document_id) const;
+
 	template<class ExecutionPolicy>
 	void RemoveDocument(ExecutionPolicy&& policy, int document_id);
 
 	void RemoveDocument(int document_id);
 
-	std::set<std::string> set_of_string_;
+	// Removes all document_ids at once: each affected posting list is compacted
+	// in a single pass, terms in parallel under par. Throws before changing
+	// anything if an id is unknown.
+	template<class ExecutionPolicy>
+	void RemoveDocuments(ExecutionPolicy&& policy, const std::vector<int>& document_ids);
+
+	void RemoveDocuments(const std::vector<int>& document_ids);
+
+	IndexStats GetIndexStats() const;
+
+	void SetQueryEvaluation(QueryEvaluation query_evaluation);
+
+	void SaveSnapshot(const std::string& path, PostingFormat posting_format = PostingFormat::RAW) const;
+
+	// Scores with the IDF of corpus_stats instead of this server's own, except for
+	// words the stats do not count; the stats must outlive this server. nullptr switches back.
+	void SetCorpusStats(const CorpusStats* corpus_stats);
+
+	// Changes whenever a document is added or removed, or SetCorpusStats is called.
+	uint64_t GetVersion() const;
+
+	// The version of the CorpusStats set by SetCorpusStats, 0 without one. Results
+	// stay the same while both this and GetVersion do.
+	uint64_t GetCorpusStatsVersion() const;
+
+	// Replaces normalized_query with the query's plus and minus words, stop words
+	// dropped, sorted and deduplicated: queries that normalize equally give equal results.
+	void NormalizeQuery(std::string_view raw_query, std::string& normalized_query) const;
+
 private:
 	struct DocumentData {
+		int ordinal;
+		int word_count;
+	};
+	// What the query loop needs per posting, kept dense by ordinal.
+	struct OrdinalDocument {
+		int id;
 		int rating;
 		DocumentStatus status;
 	};
-	const std::set<std::string> stop_words_;
-	std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
+	const std::set<std::string, std::less<>> stop_words_;
+	InvertedIndex index_;
 	std::map<int, std::map<std::string_view, double>> id_to_word_freqs_;
 	std::map<int, DocumentData> documents_;
+	std::vector<OrdinalDocument> ordinal_documents_;
+	// Bit o of status_bitmaps_[s] is set while the document with ordinal o has status s.
+	std::array<std::vector<uint64_t>, DOCUMENT_STATUS_COUNT> status_bitmaps_;
 	std::set<int> document_ids_;
-
-	template<class ExecutionPolicy>
-	bool IsValidWord(ExecutionPolicy&& policy, std::string_view word) const;
+	QueryEvaluation query_evaluation_ = QueryEvaluation::EXHAUSTIVE;
+	uint64_t version_ = 0;
+	const CorpusStats* corpus_stats_ = nullptr;
 
 	bool IsValidWord(std::string_view word) const;
 
-	bool IsStopWord(const std::string& word) const;
+	bool IsStopWord(std::string_view word) const;
 
-	std::vector<std::string> SplitIntoWordsNoStop(const std::string& text) const;
+	void CompactTerms();
 
-	int ComputeAverageRating(const std::vector<int>& ratings) const;
+	// Points every document's word views at the terms of index_.
+	void RebindWordFrequencies();
 
-	struct QueryWord {
-		std::string data;
-		bool is_minus;
-		bool is_stop;
-	};
+	bool NeedsOrdinalCompaction() const;
 
-	QueryWord ParseQueryWord(std::string_view text) const;
+	void CompactOrdinals();
 
-	struct Query {
-		std::vector<std::string> plus_words;
-		std::vector<std::string> minus_words;
+	struct DocumentBatchShard {
+		size_t first_document = 0;
+		size_t last_document = 0;
+		std::unordered_map<std::string_view, int> term_ids;
+		std::vector<std::string_view> terms;
+		std::vector<int> term_document_counts;
+		std::vector<double> max_term_freqs;
+		std::vector<std::pair<int, double>> document_terms;
+		std::vector<size_t> document_term_ends;
+		std::vector<int> document_word_counts;
+		std::vector<int> global_term_ids;
+		std::vector<size_t> posting_offsets;
+		bool is_valid = true;
 	};
 
-	Query ParseQuery(std::string_view text, bool unique) const;
+	void TokenizeBatchShard(const std::vector<RawDocument>& documents, DocumentBatchShard& shard) const;
+
+	// Words are views into text, and the returned Query is a per-thread scratch
+	// reused by the next ParseQuery call on the same thread.
+	const Query& ParseQuery(std::string_view text, bool unique) const;
+
+	const Query& ParseQuery(std::execution::sequenced_policy, std::string_view text, bool unique) const;
 
-	Query ParseQuery(std::execution::sequenced_policy, std::string_view text, bool unique) const;
+	const Query& ParseQuery(std::execution::parallel_policy, std::string_view text, bool unique) const;
 
-	Query ParseQuery(std::execution::parallel_policy, std::string_view text, bool unique) const;
+	double ComputeWordInverseDocumentFreq(std::string_view word, const InvertedIndex::PostingList& postings, const CorpusStats* corpus_stats) const;
 
-	double ComputeWordInverseDocumentFreq(std::string_view word) const;
+	void SetStatusBit(DocumentStatus status, int document_ordinal, bool value);
+
+	template <typename DocumentPredicate>
+	bool IsAllowed(const DocumentPredicate& document_predicate, int document_ordinal) const;
+
+	static std::vector<double>& GetRelevanceScratch(size_t size);
+
+	struct QueryPostings {
+		std::vector<std::pair<const InvertedIndex::PostingList*, double>> plus_postings;
+		std::vector<const InvertedIndex::PostingList*> minus_postings;
+	};
+
+	// Plus words carry the IDF of corpus_stats, or of this server's own documents when it is nullptr.
+	QueryPostings GetQueryPostings(const Query& query, const CorpusStats* corpus_stats) const;
+
+	template <typename DocumentPredicate>
+	std::vector<Document> FindTopDocumentsInPostings(const QueryPostings& query_postings, DocumentPredicate document_predicate, size_t top_count) const;
+
+	template <typename DocumentPredicate>
+	std::vector<Document> FindAllDocuments(const QueryPostings& query_postings, DocumentPredicate document_predicate) const;
 
 	template <typename DocumentPredicate>
-	std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
+	std::vector<Document> FindTopDocumentsMaxScore(const QueryPostings& query_postings, DocumentPredicate document_predicate, size_t top_count) const;
 
 	template <typename DocumentPredicate>
 	std::vector<Document> FindAllDocuments(std::execution::parallel_policy, const Query& query, DocumentPredicate document_predicate) const;
+
+	// Query words that occur in the index, as the index's own sorted views.
+	struct MatchTerms {
+		std::vector<std::string_view> plus_terms;
+		std::vector<std::string_view> minus_terms;
+	};
+
+	MatchTerms GetMatchTerms(std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchTermsInDocument(const MatchTerms& terms, int document_id) const;
+
+	template <typename DocumentPredicate>
+	void FindPartitionDocuments(const QueryPostings& query_postings, int first_ordinal, int last_ordinal, DocumentPredicate document_predicate, std::vector<Document>& matched_documents) const;
 };
 
 template <typename StringContainer>
@@ -135,54 +282,30 @@ SearchServer::SearchServer(const StringContainer& stop_words)
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
-	//LOG_DURATION_STREAM((std::string)"FTD", std::cerr);
-	const Query query = ParseQuery(raw_query, true);
-	auto matched_documents = FindAllDocuments(query, document_predicate);
-
-	std::sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-		if (std::abs(lhs.relevance - rhs.relevance) < RELEVANCE_ROUNDING) {
-			return lhs.rating > rhs.rating;
-		}
-		else {
-			return lhs.relevance > rhs.relevance;
-		}
-		});
-	if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-		matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-	}
-	return matched_documents;
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t top_count) const {
+	return FindTopDocumentsInPostings(GetQueryPostings(ParseQuery(raw_query, true), corpus_stats_), document_predicate, top_count);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t top_count, const CorpusStats& corpus_stats) const {
+	return FindTopDocumentsInPostings(GetQueryPostings(ParseQuery(raw_query, true), &corpus_stats), document_predicate, top_count);
 }
 
 template <typename DocumentPredicate, class ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
-	//LOG_DURATION_STREAM((std::string)"FTD", std::cerr);
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&&, std::string_view raw_query, DocumentPredicate document_predicate, size_t top_count) const {
 	if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
-		return FindTopDocuments(raw_query, document_predicate);
-
+		return FindTopDocuments(raw_query, document_predicate, top_count);
 	}
+	// Copied: a worker stealing another query's task on this thread would reuse the scratch.
 	const Query query = ParseQuery(std::execution::par, raw_query, true);
-	auto matched_documents = FindAllDocuments(std::execution::par, query, document_predicate);
-
-	std::sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-		if (std::abs(lhs.relevance - rhs.relevance) < RELEVANCE_ROUNDING) {
-			return lhs.rating > rhs.rating;
-		}
-		else {
-			return lhs.relevance > rhs.relevance;
-		}
-		});
-	if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-		matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-	}
-	return matched_documents;
+	const std::vector<Document> matched_documents = FindAllDocuments(std::execution::par, query, document_predicate);
+	QUERY_STAGE(TOP_K);
+	return SelectTopDocuments(std::execution::par, matched_documents, top_count);
 }
 
 template<class ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const {
-	return SearchServer::FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-		return document_status == status;
-		});
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status, size_t top_count) const {
+	return SearchServer::FindTopDocuments(policy, raw_query, DocumentStatusFilter{ status }, top_count);
 }
 
 template<class ExecutionPolicy>
@@ -190,93 +313,441 @@ std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, s
 	return SearchServer::FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
+template<class ExecutionPolicy>
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(ExecutionPolicy&&, std::string_view raw_query, const std::vector<int>& document_ids) const {
+	const MatchTerms terms = GetMatchTerms(raw_query, document_ids);
+	std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> matches(document_ids.size());
+	const auto match = [this, &terms](int document_id) {
+		return MatchTermsInDocument(terms, document_id);
+	};
+	if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>) {
+		if (document_ids.size() >= MIN_PARALLEL_MATCH_DOCUMENTS) {
+			std::transform(std::execution::par, document_ids.begin(), document_ids.end(), matches.begin(), match);
+			return matches;
+		}
+	}
+	std::transform(document_ids.begin(), document_ids.end(), matches.begin(), match);
+	return matches;
+}
+
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-	std::map<int, double> document_to_relevance;
-	for (const std::string& word : query.plus_words) {
-		if (word_to_document_freqs_.count(word) == 0) {
-			continue;
+bool SearchServer::IsAllowed(const DocumentPredicate& document_predicate, int document_ordinal) const {
+	if constexpr (std::is_same_v<DocumentPredicate, DocumentStatusFilter>) {
+		const std::vector<uint64_t>& bitmap = status_bitmaps_[static_cast<size_t>(document_predicate.status)];
+		return (bitmap[document_ordinal / 64] >> (document_ordinal % 64)) & 1;
+	}
+	else {
+		const OrdinalDocument& document = ordinal_documents_[document_ordinal];
+		return document_predicate(document.id, document.status, document.rating);
+	}
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsInPostings(const QueryPostings& query_postings, DocumentPredicate document_predicate, size_t top_count) const {
+	if (query_evaluation_ == QueryEvaluation::MAX_SCORE) {
+		return FindTopDocumentsMaxScore(query_postings, document_predicate, top_count);
+	}
+	const std::vector<Document> matched_documents = FindAllDocuments(query_postings, document_predicate);
+	QUERY_STAGE(TOP_K);
+	return SelectTopDocuments(matched_documents, top_count);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(const QueryPostings& query_postings, DocumentPredicate document_predicate) const {
+	std::vector<Document> matched_documents;
+	FindPartitionDocuments(query_postings, 0, static_cast<int>(ordinal_documents_.size()), document_predicate, matched_documents);
+	return matched_documents;
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsMaxScore(const QueryPostings& query_postings, DocumentPredicate document_predicate, size_t top_count) const {
+	if (top_count == 0 || query_postings.plus_postings.empty()) {
+		return {};
+	}
+	struct Cursor {
+		const InvertedIndex::PostingList* postings;
+		double inverse_document_freq;
+		double max_score;
+		size_t position;
+	};
+	// Terms sorted by upper bound: a prefix whose summed bound cannot reach the current
+	// top-K threshold is non-essential and never produces candidates on its own.
+	std::vector<Cursor> cursors;
+	for (const auto& [postings, inverse_document_freq] : query_postings.plus_postings) {
+		cursors.push_back({ postings, inverse_document_freq, postings->max_term_freq * inverse_document_freq, 0 });
+	}
+	std::sort(cursors.begin(), cursors.end(), [](const Cursor& lhs, const Cursor& rhs) {
+		return lhs.max_score < rhs.max_score;
+		});
+	std::vector<double> prefix_bounds(cursors.size());
+	for (size_t i = 0; i < cursors.size(); ++i) {
+		prefix_bounds[i] = cursors[i].max_score + (i > 0 ? prefix_bounds[i - 1] : 0);
+	}
+	std::vector<Cursor> minus_cursors;
+	for (const InvertedIndex::PostingList* postings : query_postings.minus_postings) {
+		minus_cursors.push_back({ postings, 0, 0, 0 });
+	}
+	const auto advance_to = [](Cursor& cursor, int ordinal) {
+		const auto& ordinals = cursor.postings->document_ordinals;
+		if (cursor.position < ordinals.size() && ordinals[cursor.position] < ordinal) {
+			cursor.position = std::lower_bound(ordinals.begin() + cursor.position, ordinals.end(), ordinal) - ordinals.begin();
 		}
-		const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-		for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-			if (term_freq == 0) {
-				continue;
+		return cursor.position < ordinals.size() && ordinals[cursor.position] == ordinal;
+	};
+
+	size_t first_essential = 0;
+	double threshold = 0;
+	TopDocuments top_documents(top_count);
+	std::vector<double>& relevance = GetRelevanceScratch(MAX_SCORE_WINDOW);
+	std::vector<int> touched;
+	std::vector<int> candidates;
+	std::vector<double> candidate_relevance;
+	QUERY_STAGE_TOTAL(accumulate_time, ACCUMULATE);
+	QUERY_STAGE_TOTAL(minus_filter_time, MINUS_FILTER);
+	QUERY_STAGE_TOTAL(top_k_time, TOP_K);
+	const auto next_window_start = [&] {
+		QUERY_STAGE_SCOPE(accumulate_time);
+		int window_start = std::numeric_limits<int>::max();
+		for (size_t i = first_essential; i < cursors.size(); ++i) {
+			if (cursors[i].position < cursors[i].postings->size()) {
+				window_start = std::min(window_start, cursors[i].postings->document_ordinals[cursors[i].position]);
+			}
+		}
+		return window_start;
+	};
+	// Windows of ordinals are scored like FindPartitionDocuments, but from the essential
+	// terms only; the rest are looked up for the few documents that may still make the top.
+	for (int window_start = next_window_start(); window_start != std::numeric_limits<int>::max(); window_start = next_window_start()) {
+		{
+			QUERY_STAGE_SCOPE(accumulate_time);
+			const int window_end = window_start + MAX_SCORE_WINDOW;
+			touched.clear();
+			for (size_t i = first_essential; i < cursors.size(); ++i) {
+				Cursor& cursor = cursors[i];
+				const auto& ordinals = cursor.postings->document_ordinals;
+				for (; cursor.position < ordinals.size() && ordinals[cursor.position] < window_end; ++cursor.position) {
+					const double term_freq = cursor.postings->term_freqs[cursor.position];
+					if (term_freq == 0) {
+						continue;
+					}
+					const int local = ordinals[cursor.position] - window_start;
+					if (relevance[local] == RELEVANCE_NOT_MATCHED) {
+						touched.push_back(local);
+						if (!IsAllowed(document_predicate, ordinals[cursor.position])) {
+							relevance[local] = RELEVANCE_EXCLUDED;
+							continue;
+						}
+						relevance[local] = 0;
+					}
+					else if (relevance[local] == RELEVANCE_EXCLUDED) {
+						continue;
+					}
+					relevance[local] += term_freq * cursor.inverse_document_freq;
+				}
 			}
-			const auto& document_data = documents_.at(document_id);
-			if (document_predicate(document_id, document_data.status, document_data.rating)) {
-				document_to_relevance[document_id] += term_freq * inverse_document_freq;
+
+			// Non-essential cursors only move forward, so documents go in ordinal order.
+			std::sort(touched.begin(), touched.end());
+			const bool is_full = top_documents.IsFull();
+			candidates.clear();
+			candidate_relevance.clear();
+			for (const int local : touched) {
+				double score = relevance[local];
+				relevance[local] = RELEVANCE_NOT_MATCHED;
+				if (score < 0 || (is_full && first_essential > 0 && score + prefix_bounds[first_essential - 1] < threshold)) {
+					continue;
+				}
+				const int ordinal = window_start + local;
+				bool is_pruned = false;
+				for (size_t i = first_essential; i-- > 0;) {
+					if (is_full && score + prefix_bounds[i] < threshold) {
+						is_pruned = true;
+						break;
+					}
+					if (advance_to(cursors[i], ordinal)) {
+						score += cursors[i].postings->term_freqs[cursors[i].position] * cursors[i].inverse_document_freq;
+					}
+				}
+				if (!is_pruned && (!is_full || score >= threshold)) {
+					candidates.push_back(ordinal);
+					candidate_relevance.push_back(score);
+				}
 			}
 		}
-	}
-	for (const std::string& word : query.minus_words) {
-		if (word_to_document_freqs_.count(word) == 0) {
-			continue;
+
+		{
+			QUERY_STAGE_SCOPE(minus_filter_time);
+			size_t kept = 0;
+			for (size_t i = 0; i < candidates.size(); ++i) {
+				if (std::none_of(minus_cursors.begin(), minus_cursors.end(), [&](Cursor& cursor) {
+					return advance_to(cursor, candidates[i]);
+					})) {
+					candidates[kept] = candidates[i];
+					candidate_relevance[kept] = candidate_relevance[i];
+					++kept;
+				}
+			}
+			candidates.resize(kept);
+			candidate_relevance.resize(kept);
 		}
-		for (const auto& [document_id, _] : word_to_document_freqs_.at(word)) {
-			document_to_relevance.erase(document_id);
+
+		QUERY_STAGE_SCOPE(top_k_time);
+		for (size_t i = 0; i < candidates.size(); ++i) {
+			const OrdinalDocument& document = ordinal_documents_[candidates[i]];
+			top_documents.Add({ document.id, candidate_relevance[i], document.rating });
+		}
+		QUERY_COUNT(DOCUMENTS_MATCHED, candidates.size());
+		if (top_documents.IsFull()) {
+			threshold = top_documents.GetWorst().relevance - 2 * RELEVANCE_ROUNDING;
+			while (first_essential < cursors.size() && prefix_bounds[first_essential] < threshold) {
+				++first_essential;
+			}
 		}
 	}
+	QUERY_COUNT(POSTINGS_SCANNED, std::accumulate(cursors.begin(), cursors.end(), size_t{ 0 }, [](size_t sum, const Cursor& cursor) {
+		return sum + cursor.position;
+		}));
+	QUERY_STAGE_SCOPE(top_k_time);
+	return top_documents.Extract();
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy, const Query& query, DocumentPredicate document_predicate) const {
+	const QueryPostings query_postings = GetQueryPostings(query, corpus_stats_);
+	const int ordinal_count = static_cast<int>(ordinal_documents_.size());
+	const int partition_count = std::max(1, std::min<int>(std::thread::hardware_concurrency() * PARTITIONS_PER_THREAD,
+		(ordinal_count + MIN_ORDINALS_PER_PARTITION - 1) / MIN_ORDINALS_PER_PARTITION));
+	const int partition_size = (ordinal_count + partition_count - 1) / partition_count;
+	std::vector<std::vector<Document>> partition_documents(partition_count);
+	std::vector<int> partitions(partition_count);
+	std::iota(partitions.begin(), partitions.end(), 0);
+
+	std::for_each(std::execution::par, partitions.begin(), partitions.end(), [&](int partition) {
+		const int first_ordinal = partition * partition_size;
+		const int last_ordinal = std::min(ordinal_count, first_ordinal + partition_size);
+		FindPartitionDocuments(query_postings, first_ordinal, last_ordinal, document_predicate, partition_documents[partition]);
+		});
+
 	std::vector<Document> matched_documents;
-	for (const auto& [document_id, relevance] : document_to_relevance) {
-		matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+	for (const auto& documents : partition_documents) {
+		matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
 	}
 	return matched_documents;
 }
 
-template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy, const Query& query, DocumentPredicate document_predicate) const {
-	ConcurrentMap<int, double> document_to_relevance(CONCURRENT_MAP_PARTS);
-	std::for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(), [&](std::string_view word) {
-		if (word_to_document_freqs_.count(word) == 0) {
-			return;
-		}
-		const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-		for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-			if (term_freq == 0) {
-				continue;
+template <typename DocumentPredicate>
+void SearchServer::FindPartitionDocuments(const QueryPostings& query_postings, int first_ordinal, int last_ordinal, DocumentPredicate document_predicate, std::vector<Document>& matched_documents) const {
+	if (first_ordinal >= last_ordinal) {
+		return;
+	}
+	std::vector<double>& relevance = GetRelevanceScratch(last_ordinal - first_ordinal);
+	std::vector<int> touched;
+	{
+		QUERY_STAGE(ACCUMULATE);
+		for (const auto& [postings, inverse_document_freq] : query_postings.plus_postings) {
+			const auto& ordinals = postings->document_ordinals;
+			const size_t first = std::lower_bound(ordinals.begin(), ordinals.end(), first_ordinal) - ordinals.begin();
+			size_t i = first;
+			for (; i < ordinals.size() && ordinals[i] < last_ordinal; ++i) {
+				const double term_freq = postings->term_freqs[i];
+				if (term_freq == 0) {
+					continue;
+				}
+				const int local = ordinals[i] - first_ordinal;
+				if (relevance[local] == RELEVANCE_NOT_MATCHED) {
+					if (!IsAllowed(document_predicate, ordinals[i])) {
+						relevance[local] = RELEVANCE_EXCLUDED;
+						touched.push_back(local);
+						continue;
+					}
+					relevance[local] = 0;
+					touched.push_back(local);
+				}
+				else if (relevance[local] == RELEVANCE_EXCLUDED) {
+					continue;
+				}
+				relevance[local] += term_freq * inverse_document_freq;
 			}
-			const auto& document_data = documents_.at(document_id);
-			if (document_predicate(document_id, document_data.status, document_data.rating)) {
-				document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+			QUERY_COUNT(POSTINGS_SCANNED, i - first);
+		}
+	}
+	QUERY_STAGE(MINUS_FILTER);
+	for (const InvertedIndex::PostingList* postings : query_postings.minus_postings) {
+		const auto& ordinals = postings->document_ordinals;
+		auto it = std::lower_bound(ordinals.begin(), ordinals.end(), first_ordinal);
+		for (; it != ordinals.end() && *it < last_ordinal; ++it) {
+			if (relevance[*it - first_ordinal] >= 0) {
+				relevance[*it - first_ordinal] = RELEVANCE_EXCLUDED;
 			}
 		}
-		});
-	std::for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(), [&](std::string_view word) {
-		if (word_to_document_freqs_.count(word) == 0) {
-			return;
+	}
+	[[maybe_unused]] const size_t matched_before = matched_documents.size();
+	for (const int local : touched) {
+		if (relevance[local] >= 0) {
+			const OrdinalDocument& document = ordinal_documents_[first_ordinal + local];
+			matched_documents.push_back({ document.id, relevance[local], document.rating });
 		}
-		for (const auto& [document_id, _] : word_to_document_freqs_.at(word)) {
-			document_to_relevance.erase(document_id);
+		relevance[local] = RELEVANCE_NOT_MATCHED;
+	}
+	QUERY_COUNT(DOCUMENTS_MATCHED, matched_documents.size() - matched_before);
+}
+
+template<class ExecutionPolicy>
+void SearchServer::AddDocuments(ExecutionPolicy&& policy, const std::vector<RawDocument>& documents) {
+	std::set<int> batch_ids;
+	for (const RawDocument& document : documents) {
+		if (document.id < 0) {
+			throw std::invalid_argument("Отрицательный идентификатор");
+		}
+		if (document_ids_.count(document.id) == 1 || !batch_ids.insert(document.id).second) {
+			throw std::invalid_argument("Идентификатор используется");
 		}
+	}
+
+	const size_t shard_count = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency() * PARTITIONS_PER_THREAD,
+		documents.size() / MIN_DOCUMENTS_PER_BATCH_SHARD));
+	const size_t shard_size = (documents.size() + shard_count - 1) / shard_count;
+	std::vector<DocumentBatchShard> shards(shard_count);
+	for (size_t i = 0; i < shard_count; ++i) {
+		shards[i].first_document = std::min(documents.size(), i * shard_size);
+		shards[i].last_document = std::min(documents.size(), (i + 1) * shard_size);
+	}
+	std::for_each(policy, shards.begin(), shards.end(), [&](DocumentBatchShard& shard) {
+		TokenizeBatchShard(documents, shard);
 		});
-	std::vector<Document> matched_documents;
-	for (const auto& [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
-		matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+	// Tokenizing validates the text too; nothing shared has been touched yet.
+	if (!std::all_of(shards.begin(), shards.end(), [](const DocumentBatchShard& shard) {
+		return shard.is_valid;
+		})) {
+		throw std::invalid_argument("Спецсимвол");
 	}
-	return matched_documents;
-}
 
+	// Shards cover consecutive ordinals, so reserving each shard's slice after the
+	// previous one keeps every posting list sorted.
+	const int first_ordinal = static_cast<int>(ordinal_documents_.size());
+	std::vector<std::map<std::string_view, double>*> word_freqs(documents.size(), nullptr);
+	for (DocumentBatchShard& shard : shards) {
+		shard.global_term_ids.resize(shard.terms.size());
+		shard.posting_offsets.resize(shard.terms.size());
+		for (size_t local_term = 0; local_term < shard.terms.size(); ++local_term) {
+			const int term_id = index_.AddTerm(shard.terms[local_term]);
+			InvertedIndex::PostingList& postings = index_.GetPostings(term_id);
+			shard.global_term_ids[local_term] = term_id;
+			shard.posting_offsets[local_term] = postings.size();
+			postings.document_ordinals.resize(postings.size() + shard.term_document_counts[local_term]);
+			postings.term_freqs.resize(postings.document_ordinals.size());
+			postings.max_term_freq = std::max(postings.max_term_freq, shard.max_term_freqs[local_term]);
+		}
+		for (size_t i = shard.first_document; i < shard.last_document; ++i) {
+			const size_t local = i - shard.first_document;
+			if (shard.document_term_ends[local + 1] > shard.document_term_ends[local]) {
+				word_freqs[i] = &id_to_word_freqs_[documents[i].id];
+			}
+		}
+	}
+	for (const DocumentBatchShard& shard : shards) {
+		for (size_t i = shard.first_document; i < shard.last_document; ++i) {
+			const int word_count = shard.document_word_counts[i - shard.first_document];
+			documents_.insert({ documents[i].id, DocumentData{ first_ordinal + static_cast<int>(i), word_count } });
+			ordinal_documents_.push_back({ documents[i].id, ComputeAverageRating(documents[i].ratings), documents[i].status });
+			SetStatusBit(documents[i].status, first_ordinal + static_cast<int>(i), true);
+			document_ids_.insert(documents[i].id);
+		}
+	}
+
+	std::for_each(policy, shards.begin(), shards.end(), [&](DocumentBatchShard& shard) {
+		for (size_t i = shard.first_document; i < shard.last_document; ++i) {
+			const size_t local = i - shard.first_document;
+			for (size_t entry = shard.document_term_ends[local]; entry < shard.document_term_ends[local + 1]; ++entry) {
+				const auto [local_term, term_freq] = shard.document_terms[entry];
+				const int term_id = shard.global_term_ids[local_term];
+				InvertedIndex::PostingList& postings = index_.GetPostings(term_id);
+				const size_t position = shard.posting_offsets[local_term]++;
+				postings.document_ordinals[position] = first_ordinal + static_cast<int>(i);
+				postings.term_freqs[position] = term_freq;
+				word_freqs[i]->emplace(index_.GetTerm(term_id), term_freq);
+			}
+		}
+		});
+	++version_;
+}
 
 template<class ExecutionPolicy>
 void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
 	if (!document_ids_.count(document_id)) {
 		throw std::invalid_argument("Документа нет");
 	};
-	std::vector<std::string_view> vec1(id_to_word_freqs_[document_id].size());
-	std::transform(policy, id_to_word_freqs_[document_id].begin(), id_to_word_freqs_[document_id].end(), vec1.begin(), [](auto& data) {
-		return data.first;
+	const auto& word_freqs = id_to_word_freqs_[document_id];
+	std::vector<int> term_ids(word_freqs.size());
+	std::transform(policy, word_freqs.begin(), word_freqs.end(), term_ids.begin(), [this](auto& data) {
+		return index_.GetTermId(data.first);
 		});
-	for_each(policy, vec1.begin(), vec1.end(), [&](auto& data) {
-		word_to_document_freqs_[data].erase(document_id);
+	const int document_ordinal = documents_.at(document_id).ordinal;
+	for_each(policy, term_ids.begin(), term_ids.end(), [&](int term_id) {
+		index_.RemovePosting(term_id, document_ordinal);
 		});
 	id_to_word_freqs_.erase(document_id);
+	SetStatusBit(ordinal_documents_[document_ordinal].status, document_ordinal, false);
 	documents_.erase(document_id);
 	document_ids_.erase(document_id);
+	++version_;
+	for (const int term_id : term_ids) {
+		index_.ReleaseTermIfUnused(term_id);
+	}
+	if (index_.NeedsTermCompaction()) {
+		CompactTerms();
+	}
+	if (NeedsOrdinalCompaction()) {
+		CompactOrdinals();
+	}
 }
 
 template<class ExecutionPolicy>
-inline bool SearchServer::IsValidWord(ExecutionPolicy&& policy, std::string_view word) const {
-	return std::none_of(policy, word.begin(), word.end(), [](char c) {
-		return c >= '\0' && c < ' ';
+void SearchServer::RemoveDocuments(ExecutionPolicy&& policy, const std::vector<int>& document_ids) {
+	for (const int document_id : document_ids) {
+		if (!document_ids_.count(document_id)) {
+			throw std::invalid_argument("Документа нет");
+		}
+	}
+	std::vector<bool> is_removed(ordinal_documents_.size(), false);
+	std::vector<int> term_ids;
+	for (const int document_id : document_ids) {
+		const int document_ordinal = documents_.at(document_id).ordinal;
+		if (is_removed[document_ordinal]) {
+			continue;
+		}
+		is_removed[document_ordinal] = true;
+		const auto it = id_to_word_freqs_.find(document_id);
+		if (it != id_to_word_freqs_.end()) {
+			for (const auto& [word, term_freq] : it->second) {
+				term_ids.push_back(index_.GetTermId(word));
+			}
+		}
+	}
+	std::sort(policy, term_ids.begin(), term_ids.end());
+	term_ids.erase(std::unique(term_ids.begin(), term_ids.end()), term_ids.end());
+	std::for_each(policy, term_ids.begin(), term_ids.end(), [&](int term_id) {
+		index_.RemovePostings(term_id, is_removed);
 		});
-}
\ No newline at end of file
+	for (const int document_id : document_ids) {
+		const auto it = documents_.find(document_id);
+		if (it == documents_.end()) {
+			continue;
+		}
+		SetStatusBit(ordinal_documents_[it->second.ordinal].status, it->second.ordinal, false);
+		id_to_word_freqs_.erase(document_id);
+		documents_.erase(it);
+		document_ids_.erase(document_id);
+	}
+	++version_;
+	for (const int term_id : term_ids) {
+		index_.ReleaseTermIfUnused(term_id);
+	}
+	if (index_.NeedsTermCompaction()) {
+		CompactTerms();
+	}
+	if (NeedsOrdinalCompaction()) {
+		CompactOrdinals();
+	}
+}
+
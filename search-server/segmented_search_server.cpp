@@ -0,0 +1,280 @@
+#include "segmented_search_server.h"
+
+SegmentedSearchServer::SegmentedSearchServer(const std::string& stop_words_text)
+	: SegmentedSearchServer(SplitIntoWords(stop_words_text))
+{
+}
+
+SegmentedSearchServer::SegmentedSearchServer(std::string_view stop_words_text)
+	: SegmentedSearchServer(SplitIntoWords((std::string)stop_words_text))
+{
+}
+
+SegmentedSearchServer::~SegmentedSearchServer() {
+	{
+		std::lock_guard guard(mutex_);
+		stopping_ = true;
+	}
+	merge_requested_.notify_one();
+	merger_.join();
+}
+
+void SegmentedSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+	if (document_id < 0) {
+		throw std::invalid_argument("Отрицательный идентификатор");
+	}
+	{
+		std::lock_guard guard(mutex_);
+		if (documents_.count(document_id) == 1) {
+			throw std::invalid_argument("Идентификатор используется");
+		}
+	}
+	thread_local std::vector<std::string_view> words;
+	if (!SplitIntoValidWords(document, words)) {
+		throw std::invalid_argument("Спецсимвол");
+	}
+	std::vector<int> term_ids;
+	for (std::string_view word : words) {
+		if (!IsStopWord(word)) {
+			term_ids.push_back(dictionary_.AddTerm(word));
+		}
+	}
+	std::sort(term_ids.begin(), term_ids.end());
+	std::vector<std::pair<int, uint32_t>> term_counts;
+	for (auto first = term_ids.begin(); first != term_ids.end();) {
+		const auto last = std::upper_bound(first, term_ids.end(), *first);
+		term_counts.push_back({ *first, static_cast<uint32_t>(last - first) });
+		if (static_cast<size_t>(*first) >= document_freqs_.size()) {
+			document_freqs_.resize(*first + 1);
+		}
+		++document_freqs_[*first];
+		first = last;
+	}
+	const int ordinal = static_cast<int>(mutable_segment_->GetDocumentCount());
+	mutable_segment_->AddDocument({ document_id, ComputeAverageRating(ratings), status, static_cast<uint32_t>(term_ids.size()) }, term_counts);
+	{
+		std::lock_guard guard(mutex_);
+		documents_[document_id] = { mutable_segment_, ordinal };
+	}
+	if (mutable_segment_->GetDocumentCount() >= MUTABLE_SEGMENT_CAPACITY) {
+		SealMutableSegment();
+	}
+}
+
+void SegmentedSearchServer::RemoveDocument(int document_id) {
+	std::shared_ptr<IndexSegment> segment;
+	int ordinal = 0;
+	{
+		std::lock_guard guard(mutex_);
+		const auto it = documents_.find(document_id);
+		if (it == documents_.end()) {
+			throw std::invalid_argument("Документа нет");
+		}
+		segment = it->second.segment;
+		ordinal = it->second.ordinal;
+		segment->Delete(ordinal);
+		documents_.erase(it);
+		if (segment->IsSealed()) {
+			merge_requested_.notify_one();
+		}
+	}
+	segment->ForEachTerm(ordinal, [this](int term_id, uint32_t) {
+		if (--document_freqs_[term_id] == 0) {
+			dictionary_.RemoveTerm(term_id);
+		}
+		});
+	if (dictionary_.NeedsCompaction()) {
+		dictionary_.Compact();
+	}
+}
+
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t top_count) const {
+	return FindTopDocuments(std::execution::seq, raw_query, status, top_count);
+}
+
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query) const {
+	return FindTopDocuments(std::execution::seq, raw_query);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SegmentedSearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+	if (!IsValidText(raw_query)) {
+		throw std::invalid_argument("Спецсимвол");
+	}
+	DocumentLocation location;
+	{
+		std::lock_guard guard(mutex_);
+		const auto it = documents_.find(document_id);
+		if (it == documents_.end()) {
+			throw std::out_of_range("Нет ID");
+		}
+		location = it->second;
+	}
+	const DocumentStatus status = location.segment->GetDocument(location.ordinal).status;
+	const QueryTerms query_terms = ParseQueryTerms(raw_query);
+	std::vector<std::string_view> matched_words;
+	for (const int term_id : query_terms.minus_terms) {
+		if (location.segment->HasTerm(location.ordinal, term_id)) {
+			return { matched_words, status };
+		}
+	}
+	for (const auto& [term_id, _] : query_terms.plus_terms) {
+		if (location.segment->HasTerm(location.ordinal, term_id)) {
+			matched_words.push_back(dictionary_.GetTerm(term_id));
+		}
+	}
+	return { matched_words, status };
+}
+
+int SegmentedSearchServer::GetDocumentCount() const {
+	std::lock_guard guard(mutex_);
+	return static_cast<int>(documents_.size());
+}
+
+size_t SegmentedSearchServer::GetSegmentCount() const {
+	std::lock_guard guard(mutex_);
+	return sealed_segments_.size() + 1;
+}
+
+size_t SegmentedSearchServer::GetMemoryUsage() const {
+	size_t memory_usage = dictionary_.GetMemoryUsage() + document_freqs_.capacity() * sizeof(int);
+	for (const auto& segment : GetSegments()) {
+		memory_usage += segment->GetMemoryUsage();
+	}
+	return memory_usage;
+}
+
+void SegmentedSearchServer::WaitForMerges() {
+	std::unique_lock lock(mutex_);
+	merge_finished_.wait(lock, [this] {
+		return !merging_ && PickSegmentsToMerge().empty();
+		});
+}
+
+bool SegmentedSearchServer::IsStopWord(std::string_view word) const {
+	return stop_words_.count(word) > 0;
+}
+
+SegmentedSearchServer::QueryTerms SegmentedSearchServer::ParseQueryTerms(std::string_view raw_query) const {
+	thread_local Query query;
+	ParseRawQuery(raw_query, true, [this](std::string_view word) {
+		return IsStopWord(word);
+		}, query);
+	QueryTerms query_terms;
+	const int document_count = GetDocumentCount();
+	for (std::string_view word : query.plus_words) {
+		const int term_id = dictionary_.GetTermId(word);
+		if (term_id != TermDictionary::NO_TERM) {
+			query_terms.plus_terms.push_back({ term_id, std::log(document_count * 1.0 / document_freqs_[term_id]) });
+		}
+	}
+	for (std::string_view word : query.minus_words) {
+		const int term_id = dictionary_.GetTermId(word);
+		if (term_id != TermDictionary::NO_TERM) {
+			query_terms.minus_terms.push_back(term_id);
+		}
+	}
+	return query_terms;
+}
+
+std::vector<std::shared_ptr<const IndexSegment>> SegmentedSearchServer::GetSegments() const {
+	std::lock_guard guard(mutex_);
+	std::vector<std::shared_ptr<const IndexSegment>> segments(sealed_segments_.begin(), sealed_segments_.end());
+	segments.push_back(mutable_segment_);
+	return segments;
+}
+
+std::vector<double>& SegmentedSearchServer::GetRelevanceScratch(size_t size) {
+	thread_local std::vector<double> relevance;
+	if (relevance.size() < size) {
+		relevance.resize(size, RELEVANCE_NOT_MATCHED);
+	}
+	return relevance;
+}
+
+void SegmentedSearchServer::SealMutableSegment() {
+	mutable_segment_->Seal();
+	{
+		std::lock_guard guard(mutex_);
+		sealed_segments_.push_back(std::move(mutable_segment_));
+		mutable_segment_ = std::make_shared<IndexSegment>();
+	}
+	merge_requested_.notify_one();
+}
+
+std::vector<std::shared_ptr<IndexSegment>> SegmentedSearchServer::PickSegmentsToMerge() const {
+	for (const auto& segment : sealed_segments_) {
+		if (segment->GetLiveDocumentCount() < segment->GetDocumentCount() - segment->GetLiveDocumentCount()) {
+			return { segment };
+		}
+	}
+	if (sealed_segments_.size() < SEGMENT_MERGE_FACTOR) {
+		return {};
+	}
+	std::vector<std::shared_ptr<IndexSegment>> segments = sealed_segments_;
+	std::sort(segments.begin(), segments.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs->GetLiveDocumentCount() < rhs->GetLiveDocumentCount();
+		});
+	segments.resize(SEGMENT_MERGE_FACTOR);
+	// Merge only a tier of similar sizes, unless segments have piled up.
+	if (sealed_segments_.size() < 2 * SEGMENT_MERGE_FACTOR
+		&& segments.back()->GetLiveDocumentCount() > SEGMENT_MERGE_FACTOR * std::max<size_t>(1, segments.front()->GetLiveDocumentCount())) {
+		return {};
+	}
+	return segments;
+}
+
+void SegmentedSearchServer::RunMerger() {
+	std::unique_lock lock(mutex_);
+	while (true) {
+		std::vector<std::shared_ptr<IndexSegment>> sources;
+		merge_requested_.wait(lock, [&] {
+			return stopping_ || !(sources = PickSegmentsToMerge()).empty();
+			});
+		if (stopping_) {
+			return;
+		}
+		std::vector<std::vector<bool>> tombstones;
+		for (const auto& source : sources) {
+			tombstones.push_back(source->GetTombstones());
+		}
+		merging_ = true;
+		lock.unlock();
+
+		// Sealed segments are immutable apart from tombstones, which were copied above.
+		const auto merged = std::make_shared<IndexSegment>();
+		std::vector<std::pair<size_t, int>> origins;
+		std::vector<std::pair<int, uint32_t>> term_counts;
+		for (size_t source = 0; source < sources.size(); ++source) {
+			for (size_t ordinal = 0; ordinal < sources[source]->GetDocumentCount(); ++ordinal) {
+				if (tombstones[source][ordinal]) {
+					continue;
+				}
+				term_counts.clear();
+				sources[source]->ForEachTerm(ordinal, [&term_counts](int term_id, uint32_t term_count) {
+					term_counts.push_back({ term_id, term_count });
+					});
+				merged->AddDocument(sources[source]->GetDocument(ordinal), term_counts);
+				origins.push_back({ source, static_cast<int>(ordinal) });
+			}
+		}
+		merged->Seal();
+
+		lock.lock();
+		for (size_t ordinal = 0; ordinal < origins.size(); ++ordinal) {
+			const auto [source, source_ordinal] = origins[ordinal];
+			if (sources[source]->IsDeleted(source_ordinal)) {
+				merged->Delete(static_cast<int>(ordinal));
+				continue;
+			}
+			documents_[merged->GetDocument(ordinal).id] = { merged, static_cast<int>(ordinal) };
+		}
+		sealed_segments_.erase(std::remove_if(sealed_segments_.begin(), sealed_segments_.end(), [&sources](const auto& segment) {
+			return std::find(sources.begin(), sources.end(), segment) != sources.end();
+			}), sealed_segments_.end());
+		if (merged->GetLiveDocumentCount() > 0) {
+			sealed_segments_.push_back(merged);
+		}
+		merging_ = false;
+		merge_finished_.notify_all();
+	}
+}
@@ -0,0 +1,194 @@
+#pragma once
+#include "search_server.h"
+#include "index_segment.h"
+#include "term_dictionary.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+const size_t MUTABLE_SEGMENT_CAPACITY = 4096;
+const size_t SEGMENT_MERGE_FACTOR = 4;
+
+// New documents go to a mutable segment that is sealed once it holds
+// MUTABLE_SEGMENT_CAPACITY documents. Removal leaves a tombstone. A background
+// thread merges sealed segments of similar size (and segments that are mostly
+// tombstones), dropping deleted documents. Document frequencies and the document
+// count are kept for the whole index, so relevance matches SearchServer.
+// Like SearchServer, calls must not overlap with AddDocument/RemoveDocument;
+// the merger synchronizes with them internally.
+class SegmentedSearchServer {
+public:
+	explicit SegmentedSearchServer(const std::string& stop_words_text);
+
+	explicit SegmentedSearchServer(std::string_view stop_words_text);
+
+	template <typename StringContainer>
+	explicit SegmentedSearchServer(const StringContainer& stop_words);
+
+	SegmentedSearchServer(const SegmentedSearchServer&) = delete;
+
+	SegmentedSearchServer& operator=(const SegmentedSearchServer&) = delete;
+
+	~SegmentedSearchServer();
+
+	void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+	void RemoveDocument(int document_id);
+
+	template <typename DocumentPredicate>
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+	std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+	template <class ExecutionPolicy, typename DocumentPredicate>
+	std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+	template <class ExecutionPolicy>
+	std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+	template <class ExecutionPolicy>
+	std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const;
+
+	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+	int GetDocumentCount() const;
+
+	// Sealed segments plus the mutable one.
+	size_t GetSegmentCount() const;
+
+	size_t GetMemoryUsage() const;
+
+	void WaitForMerges();
+
+private:
+	struct DocumentLocation {
+		std::shared_ptr<IndexSegment> segment;
+		int ordinal = 0;
+	};
+
+	struct QueryTerms {
+		std::vector<std::pair<int, double>> plus_terms;
+		std::vector<int> minus_terms;
+	};
+
+	const std::set<std::string, std::less<>> stop_words_;
+	TermDictionary dictionary_;
+	std::vector<int> document_freqs_;
+	std::shared_ptr<IndexSegment> mutable_segment_ = std::make_shared<IndexSegment>();
+
+	// Shared with the merger.
+	mutable std::mutex mutex_;
+	std::map<int, DocumentLocation> documents_;
+	std::vector<std::shared_ptr<IndexSegment>> sealed_segments_;
+	bool merging_ = false;
+	bool stopping_ = false;
+	std::condition_variable merge_requested_;
+	std::condition_variable merge_finished_;
+	std::thread merger_;
+
+	bool IsStopWord(std::string_view word) const;
+
+	QueryTerms ParseQueryTerms(std::string_view raw_query) const;
+
+	std::vector<std::shared_ptr<const IndexSegment>> GetSegments() const;
+
+	template <typename DocumentPredicate>
+	static std::vector<Document> FindTopSegmentDocuments(const IndexSegment& segment, const QueryTerms& query_terms, DocumentPredicate document_predicate, size_t top_count);
+
+	static std::vector<double>& GetRelevanceScratch(size_t size);
+
+	void SealMutableSegment();
+
+	std::vector<std::shared_ptr<IndexSegment>> PickSegmentsToMerge() const;
+
+	void RunMerger();
+};
+
+template <typename StringContainer>
+SegmentedSearchServer::SegmentedSearchServer(const StringContainer& stop_words)
+	: stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+{
+	if (!all_of(stop_words_.begin(), stop_words_.end(), [](auto& word) {
+			return IsValidText(word);
+		})) {
+		throw std::invalid_argument("Спецсимвол");
+	}
+	merger_ = std::thread([this] {
+		RunMerger();
+		});
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t top_count) const {
+	return FindTopDocuments(std::execution::seq, raw_query, document_predicate, top_count);
+}
+
+template <class ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate, size_t top_count) const {
+	const QueryTerms query_terms = ParseQueryTerms(raw_query);
+	const std::vector<std::shared_ptr<const IndexSegment>> segments = GetSegments();
+	std::vector<std::vector<Document>> segment_documents(segments.size());
+	std::transform(policy, segments.begin(), segments.end(), segment_documents.begin(), [&](const std::shared_ptr<const IndexSegment>& segment) {
+		return FindTopSegmentDocuments(*segment, query_terms, document_predicate, top_count);
+		});
+	TopDocuments top_documents(top_count);
+	for (const std::vector<Document>& documents : segment_documents) {
+		for (const Document& document : documents) {
+			top_documents.Add(document);
+		}
+	}
+	return top_documents.Extract();
+}
+
+template <class ExecutionPolicy>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status, size_t top_count) const {
+	return FindTopDocuments(policy, raw_query, DocumentStatusFilter{ status }, top_count);
+}
+
+template <class ExecutionPolicy>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const {
+	return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopSegmentDocuments(const IndexSegment& segment, const QueryTerms& query_terms, DocumentPredicate document_predicate, size_t top_count) {
+	std::vector<double>& relevance = GetRelevanceScratch(segment.GetDocumentCount());
+	std::vector<int> touched;
+	for (const auto& [term_id, inverse_document_freq] : query_terms.plus_terms) {
+		segment.ForEachPosting(term_id, [&](int ordinal, double term_freq) {
+			if (relevance[ordinal] == RELEVANCE_EXCLUDED) {
+				return;
+			}
+			if (relevance[ordinal] == RELEVANCE_NOT_MATCHED) {
+				touched.push_back(ordinal);
+				const SegmentDocument& document = segment.GetDocument(ordinal);
+				if (!document_predicate(document.id, document.status, document.rating)) {
+					relevance[ordinal] = RELEVANCE_EXCLUDED;
+					return;
+				}
+				relevance[ordinal] = 0;
+			}
+			relevance[ordinal] += term_freq * inverse_document_freq;
+			});
+	}
+	for (const int term_id : query_terms.minus_terms) {
+		segment.ForEachPosting(term_id, [&relevance](int ordinal, double) {
+			if (relevance[ordinal] >= 0) {
+				relevance[ordinal] = RELEVANCE_EXCLUDED;
+			}
+			});
+	}
+	TopDocuments top_documents(top_count);
+	for (const int ordinal : touched) {
+		if (relevance[ordinal] >= 0) {
+			const SegmentDocument& document = segment.GetDocument(ordinal);
+			top_documents.Add({ document.id, relevance[ordinal], document.rating });
+		}
+		relevance[ordinal] = RELEVANCE_NOT_MATCHED;
+	}
+	return top_documents.Extract();
+}
@@ -0,0 +1,208 @@
+#include "shard_protocol.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t FRAME_HEADER_SIZE = sizeof(uint32_t) + sizeof(uint8_t);
+const uint32_t MAX_PAYLOAD_SIZE = 1u << 30;
+
+bool MakeUnixAddress(const std::string& socket_path, sockaddr_un& address) {
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socket_path.size() >= sizeof(address.sun_path)) {
+		return false;
+	}
+	std::memcpy(address.sun_path, socket_path.data(), socket_path.size());
+	return true;
+}
+
+bool SendAll(int socket, const char* data, size_t size) {
+	while (size > 0) {
+		const ssize_t sent = send(socket, data, size, MSG_NOSIGNAL);
+		if (sent < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		data += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+bool ReceiveAll(int socket, char* data, size_t size, std::chrono::steady_clock::time_point deadline) {
+	while (size > 0) {
+		int timeout_ms = -1;
+		if (deadline != std::chrono::steady_clock::time_point::max()) {
+			const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+			if (remaining.count() <= 0) {
+				return false;
+			}
+			timeout_ms = static_cast<int>(remaining.count());
+		}
+		pollfd descriptor{ socket, POLLIN, 0 };
+		const int ready = poll(&descriptor, 1, timeout_ms);
+		if (ready < 0 && errno == EINTR) {
+			continue;
+		}
+		if (ready <= 0) {
+			return false;
+		}
+		const ssize_t received = recv(socket, data, size, 0);
+		if (received < 0 && errno == EINTR) {
+			continue;
+		}
+		if (received <= 0) {
+			return false;
+		}
+		data += received;
+		size -= received;
+	}
+	return true;
+}
+
+}
+
+void MessageWriter::WriteInt32(int32_t value) {
+	Write(&value, sizeof(value));
+}
+
+void MessageWriter::WriteUint32(uint32_t value) {
+	Write(&value, sizeof(value));
+}
+
+void MessageWriter::WriteDouble(double value) {
+	Write(&value, sizeof(value));
+}
+
+void MessageWriter::WriteString(std::string_view value) {
+	WriteUint32(static_cast<uint32_t>(value.size()));
+	Write(value.data(), value.size());
+}
+
+const std::vector<char>& MessageWriter::GetPayload() const {
+	return payload_;
+}
+
+void MessageWriter::Clear() {
+	payload_.clear();
+}
+
+void MessageWriter::Write(const void* data, size_t size) {
+	const char* bytes = static_cast<const char*>(data);
+	payload_.insert(payload_.end(), bytes, bytes + size);
+}
+
+MessageReader::MessageReader(const std::vector<char>& payload)
+	: position_(payload.data())
+	, end_(payload.data() + payload.size())
+{
+}
+
+int32_t MessageReader::ReadInt32() {
+	int32_t value;
+	Read(&value, sizeof(value));
+	return value;
+}
+
+uint32_t MessageReader::ReadUint32() {
+	uint32_t value;
+	Read(&value, sizeof(value));
+	return value;
+}
+
+double MessageReader::ReadDouble() {
+	double value;
+	Read(&value, sizeof(value));
+	return value;
+}
+
+std::string_view MessageReader::ReadString() {
+	const uint32_t size = ReadUint32();
+	if (static_cast<size_t>(end_ - position_) < size) {
+		throw std::runtime_error("Сообщение обрезано");
+	}
+	const std::string_view value(position_, size);
+	position_ += size;
+	return value;
+}
+
+void MessageReader::Read(void* data, size_t size) {
+	if (static_cast<size_t>(end_ - position_) < size) {
+		throw std::runtime_error("Сообщение обрезано");
+	}
+	std::memcpy(data, position_, size);
+	position_ += size;
+}
+
+int ListenUnixSocket(const std::string& socket_path) {
+	sockaddr_un address;
+	if (!MakeUnixAddress(socket_path, address)) {
+		return -1;
+	}
+	const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0) {
+		return -1;
+	}
+	unlink(socket_path.c_str());
+	if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || listen(listener, SOMAXCONN) < 0) {
+		close(listener);
+		return -1;
+	}
+	return listener;
+}
+
+int ConnectUnixSocket(const std::string& socket_path, std::chrono::milliseconds timeout) {
+	sockaddr_un address;
+	if (!MakeUnixAddress(socket_path, address)) {
+		return -1;
+	}
+	const auto deadline = std::chrono::steady_clock::now() + timeout;
+	while (true) {
+		const int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (connection < 0) {
+			return -1;
+		}
+		if (connect(connection, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0) {
+			return connection;
+		}
+		close(connection);
+		if (std::chrono::steady_clock::now() >= deadline) {
+			return -1;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+}
+
+bool SendMessage(int socket, uint8_t type, const std::vector<char>& payload) {
+	char header[FRAME_HEADER_SIZE];
+	const uint32_t size = static_cast<uint32_t>(payload.size());
+	std::memcpy(header, &size, sizeof(size));
+	header[sizeof(size)] = static_cast<char>(type);
+	return SendAll(socket, header, sizeof(header)) && SendAll(socket, payload.data(), payload.size());
+}
+
+bool ReceiveMessage(int socket, uint8_t& type, std::vector<char>& payload, std::chrono::steady_clock::time_point deadline) {
+	char header[FRAME_HEADER_SIZE];
+	if (!ReceiveAll(socket, header, sizeof(header), deadline)) {
+		return false;
+	}
+	uint32_t size;
+	std::memcpy(&size, header, sizeof(size));
+	if (size > MAX_PAYLOAD_SIZE) {
+		return false;
+	}
+	type = static_cast<uint8_t>(header[sizeof(size)]);
+	payload.resize(size);
+	return ReceiveAll(socket, payload.data(), size, deadline);
+}
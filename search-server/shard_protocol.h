@@ -0,0 +1,74 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Messages between ShardRouter and ShardServer processes over a Unix socket.
+// A frame is a uint32 payload size, a uint8 type and the payload. Both ends run
+// on the same host, so numbers travel in native byte order; strings are a
+// uint32 length followed by the bytes.
+enum class ShardRequest : uint8_t {
+	ADD_DOCUMENT,
+	REMOVE_DOCUMENT,
+	FIND_TOP_DOCUMENTS,
+	MATCH_DOCUMENT,
+	SHUTDOWN,
+};
+
+enum class ShardResponse : uint8_t {
+	OK,
+	INVALID_ARGUMENT,
+	OUT_OF_RANGE,
+};
+
+class MessageWriter {
+public:
+	void WriteInt32(int32_t value);
+
+	void WriteUint32(uint32_t value);
+
+	void WriteDouble(double value);
+
+	void WriteString(std::string_view value);
+
+	const std::vector<char>& GetPayload() const;
+
+	void Clear();
+
+private:
+	std::vector<char> payload_;
+
+	void Write(const void* data, size_t size);
+};
+
+// Throws std::runtime_error when the payload ends before a value does.
+class MessageReader {
+public:
+	explicit MessageReader(const std::vector<char>& payload);
+
+	int32_t ReadInt32();
+
+	uint32_t ReadUint32();
+
+	double ReadDouble();
+
+	std::string_view ReadString();
+
+private:
+	const char* position_;
+	const char* end_;
+
+	void Read(void* data, size_t size);
+};
+
+int ListenUnixSocket(const std::string& socket_path);
+
+// Retries until the listener is up or timeout passes; returns -1 on failure.
+int ConnectUnixSocket(const std::string& socket_path, std::chrono::milliseconds timeout);
+
+bool SendMessage(int socket, uint8_t type, const std::vector<char>& payload);
+
+// Reads one whole frame, waiting until deadline; false on timeout, EOF or error.
+bool ReceiveMessage(int socket, uint8_t& type, std::vector<char>& payload, std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
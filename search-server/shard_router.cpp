@@ -0,0 +1,235 @@
+#include "shard_router.h"
+#include "string_processing.h"
+
+#include <algorithm>
+#include <optional>
+
+#include <unistd.h>
+
+ShardRouter::ShardRouter(const std::vector<std::string>& socket_paths, std::chrono::milliseconds shard_timeout)
+	: shard_timeout_(shard_timeout)
+{
+	if (socket_paths.empty()) {
+		throw std::invalid_argument("Нет шардов");
+	}
+	for (const std::string& socket_path : socket_paths) {
+		shards_.push_back({ socket_path, ConnectUnixSocket(socket_path, SHARD_CONNECT_TIMEOUT) });
+		if (shards_.back().socket < 0) {
+			for (Shard& shard : shards_) {
+				Disconnect(shard);
+			}
+			throw std::runtime_error("Нет связи с шардом " + socket_path);
+		}
+	}
+}
+
+ShardRouter::~ShardRouter() {
+	for (Shard& shard : shards_) {
+		Disconnect(shard);
+	}
+}
+
+void ShardRouter::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+	if (document_id < 0) {
+		throw std::invalid_argument("Отрицательный идентификатор");
+	}
+	request_.Clear();
+	request_.WriteInt32(document_id);
+	request_.WriteInt32(static_cast<int32_t>(status));
+	request_.WriteString(document);
+	request_.WriteUint32(static_cast<uint32_t>(ratings.size()));
+	for (const int rating : ratings) {
+		request_.WriteInt32(rating);
+	}
+	MessageReader response = Call(GetShard(document_id), ShardRequest::ADD_DOCUMENT);
+	ReadWords(response);
+	corpus_stats_.AddDocument(words_);
+}
+
+void ShardRouter::RemoveDocument(int document_id) {
+	if (document_id < 0) {
+		throw std::invalid_argument("Документа нет");
+	}
+	request_.Clear();
+	request_.WriteInt32(document_id);
+	MessageReader response = Call(GetShard(document_id), ShardRequest::REMOVE_DOCUMENT);
+	ReadWords(response);
+	corpus_stats_.RemoveDocument(words_);
+}
+
+std::vector<Document> ShardRouter::FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t top_count) {
+	if (!SplitIntoValidWords(raw_query, words_)) {
+		throw std::invalid_argument("Спецсимвол");
+	}
+	for (std::string_view& word : words_) {
+		if (!word.empty() && word[0] == '-') {
+			word.remove_prefix(1);
+		}
+	}
+	std::sort(words_.begin(), words_.end());
+	words_.erase(std::unique(words_.begin(), words_.end()), words_.end());
+	words_.erase(std::remove_if(words_.begin(), words_.end(), [this](std::string_view word) {
+		return corpus_stats_.GetDocumentFreq(word) == 0;
+		}), words_.end());
+
+	request_.Clear();
+	request_.WriteString(raw_query);
+	request_.WriteInt32(static_cast<int32_t>(status));
+	request_.WriteUint32(static_cast<uint32_t>(top_count));
+	request_.WriteInt32(corpus_stats_.GetDocumentCount());
+	request_.WriteUint32(static_cast<uint32_t>(words_.size()));
+	for (const std::string_view word : words_) {
+		request_.WriteString(word);
+		request_.WriteInt32(corpus_stats_.GetDocumentFreq(word));
+	}
+
+	// All shards work on the query at once; answers are collected against one deadline.
+	std::vector<bool> is_sent(shards_.size());
+	for (size_t i = 0; i < shards_.size(); ++i) {
+		is_sent[i] = !shards_[i].is_failed && Send(shards_[i], ShardRequest::FIND_TOP_DOCUMENTS);
+	}
+	const auto deadline = std::chrono::steady_clock::now() + shard_timeout_;
+	TopDocuments top_documents(top_count);
+	std::optional<ShardResponse> error;
+	std::string error_message;
+	for (size_t i = 0; i < shards_.size(); ++i) {
+		if (shards_[i].is_failed) {
+			continue;
+		}
+		ShardResponse response_status;
+		if (!is_sent[i] || !Receive(shards_[i], response_status, deadline)) {
+			++timeout_count_;
+			continue;
+		}
+		MessageReader response(response_);
+		if (response_status != ShardResponse::OK) {
+			error = response_status;
+			error_message = response.ReadString();
+			continue;
+		}
+		for (uint32_t document_count = response.ReadUint32(); document_count > 0; --document_count) {
+			const int id = response.ReadInt32();
+			const double relevance = response.ReadDouble();
+			const int rating = response.ReadInt32();
+			top_documents.Add({ id, relevance, rating });
+		}
+	}
+	if (error) {
+		if (*error == ShardResponse::OUT_OF_RANGE) {
+			throw std::out_of_range(error_message);
+		}
+		throw std::invalid_argument(error_message);
+	}
+	return top_documents.Extract();
+}
+
+std::tuple<std::vector<std::string>, DocumentStatus> ShardRouter::MatchDocument(std::string_view raw_query, int document_id) {
+	if (document_id < 0) {
+		throw std::out_of_range("Нет ID");
+	}
+	request_.Clear();
+	request_.WriteString(raw_query);
+	request_.WriteInt32(document_id);
+	MessageReader response = Call(GetShard(document_id), ShardRequest::MATCH_DOCUMENT);
+	const DocumentStatus status = static_cast<DocumentStatus>(response.ReadInt32());
+	std::vector<std::string> words(response.ReadUint32());
+	for (std::string& word : words) {
+		word = response.ReadString();
+	}
+	return { words, status };
+}
+
+int ShardRouter::GetDocumentCount() const {
+	return corpus_stats_.GetDocumentCount();
+}
+
+size_t ShardRouter::GetShardCount() const {
+	return shards_.size();
+}
+
+uint64_t ShardRouter::GetTimeoutCount() const {
+	return timeout_count_;
+}
+
+size_t ShardRouter::GetFailedShardCount() const {
+	return std::count_if(shards_.begin(), shards_.end(), [](const Shard& shard) {
+		return shard.is_failed;
+		});
+}
+
+void ShardRouter::Shutdown() {
+	request_.Clear();
+	for (Shard& shard : shards_) {
+		Send(shard, ShardRequest::SHUTDOWN);
+		Disconnect(shard);
+	}
+}
+
+ShardRouter::Shard& ShardRouter::GetShard(int document_id) {
+	return shards_[static_cast<size_t>(document_id) % shards_.size()];
+}
+
+bool ShardRouter::Send(Shard& shard, ShardRequest type) {
+	if (shard.socket < 0) {
+		shard.socket = ConnectUnixSocket(shard.socket_path, shard_timeout_);
+		if (shard.socket < 0) {
+			return false;
+		}
+	}
+	if (!SendMessage(shard.socket, static_cast<uint8_t>(type), request_.GetPayload())) {
+		Disconnect(shard);
+		return false;
+	}
+	return true;
+}
+
+bool ShardRouter::Receive(Shard& shard, ShardResponse& status, std::chrono::steady_clock::time_point deadline) {
+	uint8_t type;
+	if (!ReceiveMessage(shard.socket, type, response_, deadline)) {
+		// A late answer would arrive out of turn, so the connection is dropped.
+		Disconnect(shard);
+		return false;
+	}
+	status = static_cast<ShardResponse>(type);
+	return true;
+}
+
+MessageReader ShardRouter::Call(Shard& shard, ShardRequest type) {
+	if (shard.is_failed) {
+		throw std::runtime_error("Шард в неизвестном состоянии: " + shard.socket_path);
+	}
+	ShardResponse status;
+	if (!Send(shard, type) || !Receive(shard, status, std::chrono::steady_clock::now() + shard_timeout_)) {
+		if (type == ShardRequest::ADD_DOCUMENT || type == ShardRequest::REMOVE_DOCUMENT) {
+			shard.is_failed = true;
+		}
+		throw std::runtime_error("Шард не ответил: " + shard.socket_path);
+	}
+	if (status != ShardResponse::OK) {
+		ThrowShardError(status);
+	}
+	return MessageReader(response_);
+}
+
+void ShardRouter::Disconnect(Shard& shard) {
+	if (shard.socket >= 0) {
+		close(shard.socket);
+		shard.socket = -1;
+	}
+}
+
+void ShardRouter::ReadWords(MessageReader& response) {
+	words_.resize(response.ReadUint32());
+	for (std::string_view& word : words_) {
+		word = response.ReadString();
+	}
+}
+
+void ShardRouter::ThrowShardError(ShardResponse status) const {
+	MessageReader response(response_);
+	const std::string message(response.ReadString());
+	if (status == ShardResponse::OUT_OF_RANGE) {
+		throw std::out_of_range(message);
+	}
+	throw std::invalid_argument(message);
+}
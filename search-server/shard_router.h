@@ -0,0 +1,84 @@
+#pragma once
+#include "corpus_stats.h"
+#include "document.h"
+#include "search_server.h"
+#include "shard_protocol.h"
+
+#include <chrono>
+#include <string>
+#include <tuple>
+#include <vector>
+
+const std::chrono::milliseconds SHARD_CONNECT_TIMEOUT(5000);
+
+// Client side of several ShardServer processes: documents go to shard
+// id % shard count, queries go to every shard at once and the per-shard top
+// lists are merged. The router counts document frequencies over all shards and
+// sends those of the query words along, so relevance matches a single
+// SearchServer holding all the documents. A shard that does not answer a query
+// within shard_timeout is left out of that result and reconnected on its next
+// request; a write that fails throws std::runtime_error. A failed write may still
+// have been applied, so its shard no longer matches the router's counts: it is
+// marked failed, refuses further calls and is left out of query results until
+// the router is recreated. Calls must not overlap.
+class ShardRouter {
+public:
+	ShardRouter(const std::vector<std::string>& socket_paths, std::chrono::milliseconds shard_timeout);
+
+	ShardRouter(const ShardRouter&) = delete;
+
+	ShardRouter& operator=(const ShardRouter&) = delete;
+
+	~ShardRouter();
+
+	void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+	void RemoveDocument(int document_id);
+
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL, size_t top_count = MAX_RESULT_DOCUMENT_COUNT);
+
+	std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id);
+
+	int GetDocumentCount() const;
+
+	size_t GetShardCount() const;
+
+	// Shard answers dropped from query results for being late or missing.
+	uint64_t GetTimeoutCount() const;
+
+	size_t GetFailedShardCount() const;
+
+	// Stops all shard processes.
+	void Shutdown();
+
+private:
+	struct Shard {
+		std::string socket_path;
+		int socket = -1;
+		bool is_failed = false;
+	};
+
+	std::vector<Shard> shards_;
+	const std::chrono::milliseconds shard_timeout_;
+	CorpusStats corpus_stats_;
+	MessageWriter request_;
+	std::vector<char> response_;
+	std::vector<std::string_view> words_;
+	uint64_t timeout_count_ = 0;
+
+	Shard& GetShard(int document_id);
+
+	bool Send(Shard& shard, ShardRequest type);
+
+	bool Receive(Shard& shard, ShardResponse& status, std::chrono::steady_clock::time_point deadline);
+
+	// Sends request_ and waits for the answer in response_; throws if the shard
+	// fails or reports an error. A write left without an answer marks the shard failed.
+	MessageReader Call(Shard& shard, ShardRequest type);
+
+	void Disconnect(Shard& shard);
+
+	void ReadWords(MessageReader& response);
+
+	[[noreturn]] void ThrowShardError(ShardResponse status) const;
+};
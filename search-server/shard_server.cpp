@@ -0,0 +1,162 @@
+#include "shard_server.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// Statuses come off the wire as plain integers and index the status bitmaps.
+DocumentStatus ReadStatus(MessageReader& request) {
+	const int32_t status = request.ReadInt32();
+	if (status < 0 || static_cast<size_t>(status) >= DOCUMENT_STATUS_COUNT) {
+		throw std::invalid_argument("Неверный статус");
+	}
+	return static_cast<DocumentStatus>(status);
+}
+
+}
+
+ShardServer::ShardServer(const std::string& stop_words_text)
+	: search_server_(stop_words_text)
+{
+}
+
+void ShardServer::Serve(const std::string& socket_path) {
+	const int listener = ListenUnixSocket(socket_path);
+	if (listener < 0) {
+		throw std::runtime_error("Не удалось открыть сокет " + socket_path);
+	}
+	std::vector<char> payload;
+	bool is_running = true;
+	while (is_running) {
+		const int connection = accept(listener, nullptr, nullptr);
+		if (connection < 0) {
+			if (errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			// Other errors do not go away on retry.
+			const std::string error = std::strerror(errno);
+			close(listener);
+			unlink(socket_path.c_str());
+			throw std::runtime_error("Не удалось принять соединение на " + socket_path + ": " + error);
+		}
+		uint8_t type;
+		while (ReceiveMessage(connection, type, payload)) {
+			if (static_cast<ShardRequest>(type) == ShardRequest::SHUTDOWN) {
+				is_running = false;
+				break;
+			}
+			MessageReader request(payload);
+			const ShardResponse status = HandleRequest(static_cast<ShardRequest>(type), request);
+			if (!SendMessage(connection, static_cast<uint8_t>(status), response_.GetPayload())) {
+				break;
+			}
+		}
+		close(connection);
+	}
+	close(listener);
+	unlink(socket_path.c_str());
+}
+
+ShardResponse ShardServer::HandleRequest(ShardRequest type, MessageReader& request) {
+	response_.Clear();
+	try {
+		switch (type) {
+		case ShardRequest::ADD_DOCUMENT:
+			AddDocument(request);
+			break;
+		case ShardRequest::REMOVE_DOCUMENT:
+			RemoveDocument(request);
+			break;
+		case ShardRequest::FIND_TOP_DOCUMENTS:
+			FindTopDocuments(request);
+			break;
+		case ShardRequest::MATCH_DOCUMENT:
+			MatchDocument(request);
+			break;
+		default:
+			throw std::invalid_argument("Неизвестный запрос");
+		}
+	}
+	catch (const std::out_of_range& e) {
+		response_.Clear();
+		response_.WriteString(e.what());
+		return ShardResponse::OUT_OF_RANGE;
+	}
+	catch (const std::exception& e) {
+		response_.Clear();
+		response_.WriteString(e.what());
+		return ShardResponse::INVALID_ARGUMENT;
+	}
+	return ShardResponse::OK;
+}
+
+// Request: id, status, text, rating count, ratings. Response: the document's words.
+void ShardServer::AddDocument(MessageReader& request) {
+	const int document_id = request.ReadInt32();
+	const DocumentStatus status = ReadStatus(request);
+	const std::string_view document = request.ReadString();
+	std::vector<int> ratings(request.ReadUint32());
+	for (int& rating : ratings) {
+		rating = request.ReadInt32();
+	}
+	search_server_.AddDocument(document_id, document, status, ratings);
+	const auto& word_freqs = search_server_.GetWordFrequencies(document_id);
+	response_.WriteUint32(static_cast<uint32_t>(word_freqs.size()));
+	for (const auto& [word, term_freq] : word_freqs) {
+		response_.WriteString(word);
+	}
+}
+
+// Request: id. Response: the removed document's words.
+void ShardServer::RemoveDocument(MessageReader& request) {
+	const int document_id = request.ReadInt32();
+	const std::map<std::string_view, double>* word_freqs = nullptr;
+	try {
+		word_freqs = &search_server_.GetWordFrequencies(document_id);
+	}
+	catch (const std::out_of_range&) {
+		throw std::invalid_argument("Документа нет");
+	}
+	response_.WriteUint32(static_cast<uint32_t>(word_freqs->size()));
+	for (const auto& [word, term_freq] : *word_freqs) {
+		response_.WriteString(word);
+	}
+	search_server_.RemoveDocument(document_id);
+}
+
+// Request: query, status, top count, corpus document count, word count,
+// (word, document frequency) pairs. Response: count, (id, relevance, rating) triples.
+void ShardServer::FindTopDocuments(MessageReader& request) {
+	const std::string_view raw_query = request.ReadString();
+	const DocumentStatus status = ReadStatus(request);
+	const size_t top_count = request.ReadUint32();
+	CorpusStats corpus_stats;
+	corpus_stats.SetDocumentCount(request.ReadInt32());
+	for (uint32_t word_count = request.ReadUint32(); word_count > 0; --word_count) {
+		const std::string_view word = request.ReadString();
+		corpus_stats.SetDocumentFreq(word, request.ReadInt32());
+	}
+	const std::vector<Document> documents = search_server_.FindTopDocuments(raw_query, DocumentStatusFilter{ status }, top_count, corpus_stats);
+	response_.WriteUint32(static_cast<uint32_t>(documents.size()));
+	for (const Document& document : documents) {
+		response_.WriteInt32(document.id);
+		response_.WriteDouble(document.relevance);
+		response_.WriteInt32(document.rating);
+	}
+}
+
+// Request: query, id. Response: status, word count, words.
+void ShardServer::MatchDocument(MessageReader& request) {
+	const std::string_view raw_query = request.ReadString();
+	const int document_id = request.ReadInt32();
+	const auto [words, status] = search_server_.MatchDocument(raw_query, document_id);
+	response_.WriteInt32(static_cast<int32_t>(status));
+	response_.WriteUint32(static_cast<uint32_t>(words.size()));
+	for (const std::string_view word : words) {
+		response_.WriteString(word);
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "search_server.h"
+#include "shard_protocol.h"
+
+#include <string>
+
+// Serves one SearchServer to a ShardRouter over a Unix socket, one request at
+// a time. Queries carry the document frequencies of the whole corpus, so the
+// shard scores with global IDF instead of its own.
+class ShardServer {
+public:
+	explicit ShardServer(const std::string& stop_words_text);
+
+	// Accepts connections one after another until a SHUTDOWN request arrives;
+	// throws std::runtime_error if the socket cannot be opened or accept fails with
+	// anything but EINTR or ECONNABORTED.
+	void Serve(const std::string& socket_path);
+
+private:
+	SearchServer search_server_;
+	MessageWriter response_;
+
+	ShardResponse HandleRequest(ShardRequest type, MessageReader& request);
+
+	void AddDocument(MessageReader& request);
+
+	void RemoveDocument(MessageReader& request);
+
+	void FindTopDocuments(MessageReader& request);
+
+	void MatchDocument(MessageReader& request);
+};
@@ -0,0 +1,63 @@
+#include "sharded_search_server.h"
+
+ShardedSearchServer::ShardedSearchServer(const std::string& stop_words_text, size_t shard_count)
+	: executor_(shard_count)
+{
+	for (size_t i = 0; i < std::max<size_t>(1, shard_count); ++i) {
+		shards_.push_back(std::make_unique<SearchServer>(stop_words_text));
+		shards_.back()->SetCorpusStats(&corpus_stats_);
+	}
+}
+
+void ShardedSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+	if (document_id < 0) {
+		throw std::invalid_argument("Отрицательный идентификатор");
+	}
+	SearchServer& shard = GetShard(document_id);
+	shard.AddDocument(document_id, document, status, ratings);
+	corpus_stats_.AddDocument(shard.GetWordFrequencies(document_id));
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+	if (document_id < 0) {
+		throw std::invalid_argument("Документа нет");
+	}
+	SearchServer& shard = GetShard(document_id);
+	const std::map<std::string_view, double>* word_freqs = nullptr;
+	try {
+		word_freqs = &shard.GetWordFrequencies(document_id);
+	}
+	catch (const std::out_of_range&) {
+		throw std::invalid_argument("Документа нет");
+	}
+	// The words point into the shard's dictionary, so count them out before removing.
+	corpus_stats_.RemoveDocument(*word_freqs);
+	shard.RemoveDocument(document_id);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t top_count) const {
+	return FindTopDocuments(raw_query, DocumentStatusFilter{ status }, top_count);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query) const {
+	return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+	if (document_id < 0) {
+		throw std::out_of_range("Нет ID");
+	}
+	return GetShard(document_id).MatchDocument(raw_query, document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+	return corpus_stats_.GetDocumentCount();
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+	return shards_.size();
+}
+
+SearchServer& ShardedSearchServer::GetShard(int document_id) const {
+	return *shards_[static_cast<size_t>(document_id) % shards_.size()];
+}
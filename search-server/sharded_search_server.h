@@ -0,0 +1,60 @@
+#pragma once
+#include "search_server.h"
+#include "corpus_stats.h"
+#include "query_executor.h"
+
+#include <memory>
+
+// Spreads documents over shard_count SearchServers by id and answers a query
+// by running it on every shard at once and merging the per-shard top lists.
+// The shards share one CorpusStats, so relevance matches a single SearchServer
+// holding all the documents. Like SearchServer, calls must not overlap with
+// AddDocument/RemoveDocument.
+class ShardedSearchServer {
+public:
+	ShardedSearchServer(const std::string& stop_words_text, size_t shard_count = std::max(1u, std::thread::hardware_concurrency()));
+
+	ShardedSearchServer(const ShardedSearchServer&) = delete;
+
+	ShardedSearchServer& operator=(const ShardedSearchServer&) = delete;
+
+	void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+	void RemoveDocument(int document_id);
+
+	template <typename DocumentPredicate>
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+	std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+	int GetDocumentCount() const;
+
+	size_t GetShardCount() const;
+
+private:
+	std::vector<std::unique_ptr<SearchServer>> shards_;
+	CorpusStats corpus_stats_;
+	// One worker per shard; a query's shard tasks are spread over them.
+	mutable QueryExecutor executor_;
+
+	SearchServer& GetShard(int document_id) const;
+};
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t top_count) const {
+	std::vector<std::vector<Document>> shard_documents(shards_.size());
+	executor_.ParallelFor(shards_.size(), [&](size_t shard) {
+		shard_documents[shard] = shards_[shard]->FindTopDocuments(raw_query, document_predicate, top_count);
+		});
+	TopDocuments top_documents(top_count);
+	for (const std::vector<Document>& documents : shard_documents) {
+		for (const Document& document : documents) {
+			top_documents.Add(document);
+		}
+	}
+	return top_documents.Extract();
+}
@@ -1,33 +1,38 @@
 #include "string_processing.h"
 
+#include <algorithm>
+
 std::vector<std::string> SplitIntoWords(const std::string& text) {
 	std::vector<std::string> words;
-	std::string word;
-	for (const char c : text) {
-		if (c == ' ') {
-			if (!word.empty()) {
-				words.push_back(word);
-				word.clear();
-			}
-		}
-		else {
-			word += c;
-		}
-	}
-	if (!word.empty()) {
-		words.push_back(word);
-	}
+	ForEachWord(text, [&words](std::string_view word) {
+		words.emplace_back(word);
+		});
 	return words;
 }
 
 std::vector<std::string_view> SplitIntoWordsView(std::string_view str) {
 	std::vector<std::string_view> result;
-	str.remove_prefix(std::min(str.size(), str.find_first_not_of(' ')));
-	while (str.size() != 0) {
-		auto space = str.find(' ');
-		result.push_back(str.substr(0, space));
-		str.remove_prefix(std::min(str.size(), space));
-		str.remove_prefix(std::min(str.size(), str.find_first_not_of(' ')));
-	}
+	ForEachWord(str, [&result](std::string_view word) {
+		result.push_back(word);
+		});
 	return result;
-}
\ No newline at end of file
+}
+
+bool SplitIntoValidWords(std::string_view text, std::vector<std::string_view>& words) {
+	words.clear();
+	return ForEachValidWord(text, [&words](std::string_view word) {
+		words.push_back(word);
+		});
+}
+
+bool IsValidText(std::string_view text) {
+	size_t offset = 0;
+	for (; offset + CHARACTER_BLOCK_SIZE <= text.size(); offset += CHARACTER_BLOCK_SIZE) {
+		if (ClassifyCharacters(text.data() + offset).controls != 0) {
+			return false;
+		}
+	}
+	return std::none_of(text.begin() + offset, text.end(), [](char c) {
+		return c >= '\0' && c < ' ';
+		});
+}
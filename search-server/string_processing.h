@@ -1,15 +1,144 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <set>
+#include <string_view>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 std::vector<std::string> SplitIntoWords(const std::string& text);
 
 std::vector<std::string_view> SplitIntoWordsView(std::string_view str);
 
+bool IsValidText(std::string_view text);
+
+const size_t CHARACTER_BLOCK_SIZE = 64;
+// Shorter texts are scanned a byte at a time: padding them out to a block costs
+// more than the SIMD classification saves.
+const size_t MIN_BLOCK_SCAN_LENGTH = 12;
+
+// Bit i is set in spaces (controls) if block[i] is a space (a character below ' ').
+struct CharacterMasks {
+	uint64_t spaces;
+	uint64_t controls;
+};
+
+// Classifies CHARACTER_BLOCK_SIZE bytes with AVX2 or SSE2 when the target has them.
+inline CharacterMasks ClassifyCharacters(const char* block) {
+	CharacterMasks masks{ 0, 0 };
+#if defined(__AVX2__)
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i minus_one = _mm256_set1_epi8(-1);
+	for (size_t i = 0; i < CHARACTER_BLOCK_SIZE; i += 32) {
+		const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+		// Signed compares: bytes from 0x80 up are negative and are not control characters.
+		const __m256i controls = _mm256_and_si256(_mm256_cmpgt_epi8(space, bytes), _mm256_cmpgt_epi8(bytes, minus_one));
+		masks.spaces |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, space)))) << i;
+		masks.controls |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(controls))) << i;
+	}
+#elif defined(__SSE2__)
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i minus_one = _mm_set1_epi8(-1);
+	for (size_t i = 0; i < CHARACTER_BLOCK_SIZE; i += 16) {
+		const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+		const __m128i controls = _mm_and_si128(_mm_cmplt_epi8(bytes, space), _mm_cmpgt_epi8(bytes, minus_one));
+		masks.spaces |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, space))) << i;
+		masks.controls |= static_cast<uint64_t>(_mm_movemask_epi8(controls)) << i;
+	}
+#else
+	for (size_t i = 0; i < CHARACTER_BLOCK_SIZE; ++i) {
+		masks.spaces |= static_cast<uint64_t>(block[i] == ' ') << i;
+		masks.controls |= static_cast<uint64_t>(block[i] >= '\0' && block[i] < ' ') << i;
+	}
+#endif
+	return masks;
+}
+
+template <bool check_controls, typename WordHandler>
+bool ScanShortWords(std::string_view text, WordHandler& handle_word) {
+	if (check_controls && std::any_of(text.begin(), text.end(), [](char c) {
+		return c >= '\0' && c < ' ';
+		})) {
+		return false;
+	}
+	size_t word_start = 0;
+	for (size_t i = 0; i < text.size(); ++i) {
+		if (text[i] == ' ') {
+			if (i > word_start) {
+				handle_word(text.substr(word_start, i - word_start));
+			}
+			word_start = i + 1;
+		}
+	}
+	if (text.size() > word_start) {
+		handle_word(text.substr(word_start));
+	}
+	return true;
+}
+
+// Calls handle_word for each space-separated word of text. With check_controls
+// the scan stops and returns false at the first block holding a control
+// character; words from earlier blocks have been handled by then.
+template <bool check_controls, typename WordHandler>
+bool ScanWords(std::string_view text, WordHandler&& handle_word) {
+	if (text.size() < MIN_BLOCK_SCAN_LENGTH) {
+		return ScanShortWords<check_controls>(text, handle_word);
+	}
+	uint64_t previous_is_word = 0;
+	size_t word_start = 0;
+	for (size_t offset = 0; offset < text.size(); offset += CHARACTER_BLOCK_SIZE) {
+		const char* block = text.data() + offset;
+		char padded_block[CHARACTER_BLOCK_SIZE];
+		if (text.size() - offset < CHARACTER_BLOCK_SIZE) {
+			std::fill(std::copy(block, text.data() + text.size(), padded_block), padded_block + CHARACTER_BLOCK_SIZE, ' ');
+			block = padded_block;
+		}
+		const CharacterMasks masks = ClassifyCharacters(block);
+		if (check_controls && masks.controls != 0) {
+			return false;
+		}
+		const uint64_t is_word = ~masks.spaces;
+		const uint64_t after_word = is_word << 1 | previous_is_word;
+		const uint64_t starts = is_word & ~after_word;
+		// Starts and ends alternate, so visiting boundaries in order pairs them up.
+		for (uint64_t boundaries = starts | (~is_word & after_word); boundaries != 0; boundaries &= boundaries - 1) {
+			const int bit = __builtin_ctzll(boundaries);
+			if (starts >> bit & 1) {
+				word_start = offset + bit;
+			}
+			else {
+				handle_word(text.substr(word_start, offset + bit - word_start));
+			}
+		}
+		previous_is_word = is_word >> 63;
+	}
+	if (previous_is_word != 0) {
+		handle_word(text.substr(word_start));
+	}
+	return true;
+}
+
+template <typename WordHandler>
+void ForEachWord(std::string_view text, WordHandler&& handle_word) {
+	ScanWords<false>(text, handle_word);
+}
+
+template <typename WordHandler>
+bool ForEachValidWord(std::string_view text, WordHandler&& handle_word) {
+	return ScanWords<true>(text, handle_word);
+}
+
+// Splits and validates text in one pass; words are views into text. Returns
+// false if text has a control character, leaving words unspecified.
+bool SplitIntoValidWords(std::string_view text, std::vector<std::string_view>& words);
+
 template <typename StringContainer>
-std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
-	std::set<std::string> non_empty_strings;
+std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
+	std::set<std::string, std::less<>> non_empty_strings;
 	for (std::string str : strings) {
 		if (!str.empty()) {
 			non_empty_strings.insert(str);
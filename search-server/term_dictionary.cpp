@@ -0,0 +1,114 @@
+#include "term_dictionary.h"
+
+#include <algorithm>
+#include <cstring>
+
+std::string_view TermDictionary::Arena::Store(std::string_view word) {
+	if (word.size() > free_in_block_) {
+		const size_t block_size = std::max(TERM_ARENA_BLOCK_SIZE, word.size());
+		blocks_.push_back(std::make_unique<char[]>(block_size));
+		capacity_ += block_size;
+		free_in_block_ = block_size;
+		position_ = blocks_.back().get();
+	}
+	std::memcpy(position_, word.data(), word.size());
+	const std::string_view stored(position_, word.size());
+	position_ += word.size();
+	free_in_block_ -= word.size();
+	return stored;
+}
+
+size_t TermDictionary::Arena::GetCapacity() const {
+	return capacity_;
+}
+
+TermDictionary::TermDictionary(const TermDictionary& other)
+	: id_to_term_(other.id_to_term_.size())
+	, free_ids_(other.free_ids_)
+	, live_bytes_(other.live_bytes_)
+{
+	for (size_t term_id = 0; term_id < id_to_term_.size(); ++term_id) {
+		if (other.id_to_term_[term_id].empty()) {
+			continue;
+		}
+		id_to_term_[term_id] = arena_.Store(other.id_to_term_[term_id]);
+		term_to_id_.emplace(id_to_term_[term_id], static_cast<int>(term_id));
+	}
+}
+
+int TermDictionary::GetTermId(std::string_view word) const {
+	const auto it = term_to_id_.find(word);
+	if (it == term_to_id_.end()) {
+		return NO_TERM;
+	}
+	return it->second;
+}
+
+int TermDictionary::AddTerm(std::string_view word) {
+	const auto it = term_to_id_.find(word);
+	if (it != term_to_id_.end()) {
+		return it->second;
+	}
+	int term_id;
+	if (free_ids_.empty()) {
+		term_id = static_cast<int>(id_to_term_.size());
+		id_to_term_.emplace_back();
+	}
+	else {
+		term_id = free_ids_.back();
+		free_ids_.pop_back();
+	}
+	const std::string_view stored = arena_.Store(word);
+	id_to_term_[term_id] = stored;
+	term_to_id_.emplace(stored, term_id);
+	live_bytes_ += stored.size();
+	return term_id;
+}
+
+void TermDictionary::RemoveTerm(int term_id) {
+	const std::string_view word = id_to_term_[term_id];
+	term_to_id_.erase(word);
+	id_to_term_[term_id] = {};
+	free_ids_.push_back(term_id);
+	live_bytes_ -= word.size();
+	dead_bytes_ += word.size();
+}
+
+std::string_view TermDictionary::GetTerm(int term_id) const {
+	return id_to_term_[term_id];
+}
+
+size_t TermDictionary::GetTermCount() const {
+	return term_to_id_.size();
+}
+
+size_t TermDictionary::GetTermIdBound() const {
+	return id_to_term_.size();
+}
+
+bool TermDictionary::NeedsCompaction() const {
+	return dead_bytes_ > TERM_ARENA_BLOCK_SIZE && dead_bytes_ > live_bytes_;
+}
+
+TermDictionary::Arena TermDictionary::Compact() {
+	Arena retired_arena = std::move(arena_);
+	arena_ = Arena();
+	term_to_id_.clear();
+	for (size_t term_id = 0; term_id < id_to_term_.size(); ++term_id) {
+		if (id_to_term_[term_id].empty()) {
+			continue;
+		}
+		id_to_term_[term_id] = arena_.Store(id_to_term_[term_id]);
+		term_to_id_.emplace(id_to_term_[term_id], static_cast<int>(term_id));
+	}
+	dead_bytes_ = 0;
+	return retired_arena;
+}
+
+size_t TermDictionary::GetMemoryUsage() const {
+	return arena_.GetCapacity()
+		+ id_to_term_.capacity() * sizeof(std::string_view)
+		+ free_ids_.capacity() * sizeof(int)
+		+ term_to_id_.bucket_count() * sizeof(void*)
+		+ term_to_id_.size() * (sizeof(std::pair<const std::string_view, int>) + 2 * sizeof(void*));
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+const size_t TERM_ARENA_BLOCK_SIZE = 64 * 1024;
+
+class TermDictionary {
+public:
+	class Arena {
+	public:
+		std::string_view Store(std::string_view word);
+
+		size_t GetCapacity() const;
+
+	private:
+		std::vector<std::unique_ptr<char[]>> blocks_;
+		size_t capacity_ = 0;
+		size_t free_in_block_ = 0;
+		char* position_ = nullptr;
+	};
+
+	static const int NO_TERM = -1;
+
+	TermDictionary() = default;
+
+	// Stores the live terms in a fresh arena under the same ids.
+	TermDictionary(const TermDictionary& other);
+
+	TermDictionary& operator=(const TermDictionary&) = delete;
+
+	int GetTermId(std::string_view word) const;
+
+	int AddTerm(std::string_view word);
+
+	void RemoveTerm(int term_id);
+
+	std::string_view GetTerm(int term_id) const;
+
+	size_t GetTermCount() const;
+
+	size_t GetTermIdBound() const;
+
+	bool NeedsCompaction() const;
+
+	Arena Compact();
+
+	size_t GetMemoryUsage() const;
+
+private:
+	Arena arena_;
+	std::unordered_map<std::string_view, int> term_to_id_;
+	std::vector<std::string_view> id_to_term_;
+	std::vector<int> free_ids_;
+	size_t live_bytes_ = 0;
+	size_t dead_bytes_ = 0;
+};
@@ -0,0 +1,1017 @@
+#include "test_example_functions.h"
+#include "corpus_generator.h"
+#include "search_server.h"
+#include "index_snapshot.h"
+#include "concurrent_search_server.h"
+#include "segmented_search_server.h"
+#include "query_cache.h"
+#include "corpus_stats.h"
+#include "remove_duplicates.h"
+#include "sharded_search_server.h"
+#include "shard_router.h"
+#include "query_executor.h"
+#include "process_queries.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+void AssertImpl(bool value, const string& expr_str, const string& file, const string& func, unsigned line, const string& hint) {
+	if (!value) {
+		cerr << file << "(" << line << "): " << func << ": ";
+		cerr << "ASSERT(" << expr_str << ") failed.";
+		if (!hint.empty()) {
+			cerr << " Hint: " << hint;
+		}
+		cerr << endl;
+		abort();
+	}
+}
+
+namespace {
+
+const double RELEVANCE_TOLERANCE = 1e-9;
+
+struct TestDocument {
+	int id;
+	string text;
+	DocumentStatus status;
+	vector<int> ratings;
+};
+
+// Short words from a small dictionary, so queries hit many documents and
+// relevance ties are common. Statuses and ratings vary.
+vector<TestDocument> GenerateTestDocuments(mt19937& generator, const vector<string>& dictionary, int document_count, int max_word_count) {
+	vector<TestDocument> documents;
+	for (int id = 0; id < document_count; ++id) {
+		const int word_count = uniform_int_distribution(0, max_word_count)(generator);
+		const DocumentStatus status = static_cast<DocumentStatus>(uniform_int_distribution(0, static_cast<int>(DOCUMENT_STATUS_COUNT) - 1)(generator));
+		vector<int> ratings(uniform_int_distribution(0, 3)(generator));
+		for (int& rating : ratings) {
+			rating = uniform_int_distribution(-10, 10)(generator);
+		}
+		documents.push_back({ id * 3, GenerateQuery(generator, dictionary, word_count), status, ratings });
+	}
+	return documents;
+}
+
+void AddTestDocuments(SearchServer& search_server, const vector<TestDocument>& documents) {
+	for (const TestDocument& document : documents) {
+		search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+	}
+}
+
+// FindTopDocuments computed the slow and obvious way from the document texts.
+template <typename DocumentPredicate>
+vector<Document> FindReferenceTopDocuments(const vector<TestDocument>& documents, const string& stop_words_text, const string& raw_query, DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) {
+	const vector<string> stop_word_list = SplitIntoWords(stop_words_text);
+	const set<string> stop_words(stop_word_list.begin(), stop_word_list.end());
+	set<string> plus_words;
+	set<string> minus_words;
+	for (const string& word : SplitIntoWords(raw_query)) {
+		const bool is_minus = word[0] == '-';
+		const string data = is_minus ? word.substr(1) : word;
+		if (stop_words.count(data) == 0) {
+			(is_minus ? minus_words : plus_words).insert(data);
+		}
+	}
+	map<int, map<string, double>> term_freqs;
+	map<string, int> document_freqs;
+	for (const TestDocument& document : documents) {
+		vector<string> words;
+		for (const string& word : SplitIntoWords(document.text)) {
+			if (stop_words.count(word) == 0) {
+				words.push_back(word);
+			}
+		}
+		map<string, double>& document_term_freqs = term_freqs[document.id];
+		for (const string& word : words) {
+			document_term_freqs[word] += 1.0 / words.size();
+		}
+		for (const auto& [word, term_freq] : document_term_freqs) {
+			++document_freqs[word];
+		}
+	}
+	vector<Document> matched_documents;
+	for (const TestDocument& document : documents) {
+		const map<string, double>& document_term_freqs = term_freqs[document.id];
+		const int rating = document.ratings.empty() ? 0 : accumulate(document.ratings.begin(), document.ratings.end(), 0) / static_cast<int>(document.ratings.size());
+		if (!document_predicate(document.id, document.status, rating)) {
+			continue;
+		}
+		if (any_of(minus_words.begin(), minus_words.end(), [&](const string& word) {
+			return document_term_freqs.count(word) > 0;
+			})) {
+			continue;
+		}
+		double relevance = 0;
+		bool is_matched = false;
+		for (const string& word : plus_words) {
+			const auto it = document_term_freqs.find(word);
+			if (it != document_term_freqs.end()) {
+				relevance += it->second * log(documents.size() * 1.0 / document_freqs[word]);
+				is_matched = true;
+			}
+		}
+		if (is_matched) {
+			matched_documents.push_back({ document.id, relevance, rating });
+		}
+	}
+	sort(matched_documents.begin(), matched_documents.end(), IsMoreRelevant);
+	if (matched_documents.size() > top_count) {
+		matched_documents.resize(top_count);
+	}
+	return matched_documents;
+}
+
+// Same ids in the same order, same ratings, relevance equal up to rounding.
+void AssertSameDocuments(const vector<Document>& documents, const vector<Document>& expected, const string& hint) {
+	ASSERT_EQUAL_HINT(documents.size(), expected.size(), hint);
+	for (size_t i = 0; i < documents.size(); ++i) {
+		ASSERT_EQUAL_HINT(documents[i].id, expected[i].id, hint);
+		ASSERT_EQUAL_HINT(documents[i].rating, expected[i].rating, hint);
+		ASSERT_HINT(abs(documents[i].relevance - expected[i].relevance) < RELEVANCE_TOLERANCE, hint);
+	}
+}
+
+}
+
+void TestExcludeStopWordsFromAddedDocumentContent() {
+	const int doc_id = 42;
+	const string content = "cat in the city"s;
+	const vector<int> ratings = { 1, 2, 3 };
+	{
+		SearchServer server(""s);
+		server.AddDocument(doc_id, content, DocumentStatus::ACTUAL, ratings);
+		const auto found_docs = server.FindTopDocuments("in"s);
+		ASSERT_EQUAL(found_docs.size(), 1u);
+		ASSERT_EQUAL(found_docs[0].id, doc_id);
+	}
+	{
+		SearchServer server("in the"s);
+		server.AddDocument(doc_id, content, DocumentStatus::ACTUAL, ratings);
+		ASSERT(server.FindTopDocuments("in"s).empty());
+	}
+}
+
+void TestMinusWordsExcludeDocuments() {
+	SearchServer server(""s);
+	server.AddDocument(1, "white cat with a collar"s, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 2 });
+	const auto found_docs = server.FindTopDocuments("cat -collar"s);
+	ASSERT_EQUAL(found_docs.size(), 1u);
+	ASSERT_EQUAL(found_docs[0].id, 2);
+	ASSERT(server.FindTopDocuments("-cat"s).empty());
+}
+
+void TestMatchDocument() {
+	SearchServer server("a with"s);
+	server.AddDocument(1, "white cat with a collar"s, DocumentStatus::BANNED, { 1 });
+	{
+		const auto [words, status] = server.MatchDocument("collar cat dog"s, 1);
+		ASSERT_EQUAL(words.size(), 2u);
+		ASSERT_EQUAL(words[0], "cat"sv);
+		ASSERT_EQUAL(words[1], "collar"sv);
+		ASSERT(status == DocumentStatus::BANNED);
+	}
+	{
+		const auto [words, status] = server.MatchDocument(execution::par, "collar cat -white"s, 1);
+		ASSERT(words.empty());
+	}
+	ASSERT_THROWS(out_of_range, server.MatchDocument("cat"s, 2));
+}
+
+void TestRelevanceRatingAndSorting() {
+	SearchServer server("and in on"s);
+	server.AddDocument(0, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+	server.AddDocument(1, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	server.AddDocument(2, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+	const auto found_docs = server.FindTopDocuments("fluffy groomed cat"s);
+	ASSERT_EQUAL(found_docs.size(), 3u);
+	ASSERT_EQUAL(found_docs[0].id, 1);
+	ASSERT_EQUAL(found_docs[1].id, 2);
+	ASSERT_EQUAL(found_docs[2].id, 0);
+	ASSERT_EQUAL(found_docs[0].rating, 5);
+	ASSERT_EQUAL(found_docs[1].rating, -1);
+	ASSERT_EQUAL(found_docs[2].rating, 2);
+	// fluffy: 2/4 * ln(3), cat: 1/4 * ln(3/2)
+	ASSERT(abs(found_docs[0].relevance - (0.5 * log(3.0) + 0.25 * log(1.5))) < RELEVANCE_TOLERANCE);
+	ASSERT(abs(found_docs[2].relevance - 0.25 * log(1.5)) < RELEVANCE_TOLERANCE);
+}
+
+void TestStatusAndPredicate() {
+	SearchServer server(""s);
+	server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(2, "cat dog"s, DocumentStatus::BANNED, { 2 });
+	server.AddDocument(3, "cat dog bird"s, DocumentStatus::IRRELEVANT, { 3 });
+	const auto banned = server.FindTopDocuments("cat"s, DocumentStatus::BANNED);
+	ASSERT_EQUAL(banned.size(), 1u);
+	ASSERT_EQUAL(banned[0].id, 2);
+	const auto odd = server.FindTopDocuments("cat"s, [](int document_id, DocumentStatus, int) {
+		return document_id % 2 == 1;
+		});
+	// "cat" is in every document, so relevance is 0 and the higher rating comes first.
+	ASSERT_EQUAL(odd.size(), 2u);
+	ASSERT_EQUAL(odd[0].id, 3);
+	ASSERT_EQUAL(odd[1].id, 1);
+	ASSERT(server.FindTopDocuments("cat"s, DocumentStatus::REMOVED).empty());
+}
+
+void TestRemoveDocument() {
+	SearchServer server(""s);
+	server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(2, "cat bird"s, DocumentStatus::ACTUAL, { 2 });
+	server.RemoveDocument(1);
+	ASSERT_EQUAL(server.GetDocumentCount(), 1);
+	ASSERT(server.FindTopDocuments("dog"s).empty());
+	ASSERT_EQUAL(server.FindTopDocuments("cat"s).size(), 1u);
+	ASSERT_THROWS(out_of_range, server.GetWordFrequencies(1));
+	ASSERT_THROWS(invalid_argument, server.RemoveDocument(1));
+	ASSERT_EQUAL(server.GetWordFrequencies(2).size(), 2u);
+	// The document id can be used again.
+	server.AddDocument(1, "dog"s, DocumentStatus::ACTUAL, { 1 });
+	ASSERT_EQUAL(server.FindTopDocuments("dog"s).size(), 1u);
+}
+
+void TestInvalidInput() {
+	ASSERT_THROWS(invalid_argument, SearchServer("in\x12"s));
+	SearchServer server(""s);
+	server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, { 1 });
+	ASSERT_THROWS(invalid_argument, server.AddDocument(1, "dog"s, DocumentStatus::ACTUAL, { 1 }));
+	ASSERT_THROWS(invalid_argument, server.AddDocument(-1, "dog"s, DocumentStatus::ACTUAL, { 1 }));
+	ASSERT_THROWS(invalid_argument, server.AddDocument(2, "d\x01og"s, DocumentStatus::ACTUAL, { 1 }));
+	ASSERT_THROWS(invalid_argument, server.FindTopDocuments("--cat"s));
+	ASSERT_THROWS(invalid_argument, server.FindTopDocuments("cat -"s));
+	ASSERT_THROWS(invalid_argument, server.FindTopDocuments("c\x02t"s));
+	ASSERT_EQUAL(server.GetDocumentCount(), 1);
+}
+
+void TestMatchesReferenceRanking() {
+	mt19937 generator(1);
+	const vector<string> dictionary = GenerateDictionary(generator, 40, 2);
+	const string stop_words = dictionary[0] + " "s + dictionary[1];
+	vector<TestDocument> documents = GenerateTestDocuments(generator, dictionary, 300, 12);
+	SearchServer search_server(stop_words);
+	AddTestDocuments(search_server, documents);
+	const auto has_even_rating = [](int, DocumentStatus, int rating) {
+		return rating % 2 == 0;
+	};
+	const auto check = [&] {
+		for (int i = 0; i < 200; ++i) {
+			const string query = GenerateQuery(generator, dictionary, uniform_int_distribution(1, 8)(generator), 0.2);
+			const vector<Document> expected = FindReferenceTopDocuments(documents, stop_words, query, DocumentStatusFilter{ DocumentStatus::ACTUAL });
+			AssertSameDocuments(search_server.FindTopDocuments(query), expected, query);
+			AssertSameDocuments(search_server.FindTopDocuments(execution::par, query), expected, query);
+			AssertSameDocuments(search_server.FindTopDocuments(query, has_even_rating),
+				FindReferenceTopDocuments(documents, stop_words, query, has_even_rating), query);
+		}
+	};
+	check();
+	for (size_t i = 0; i < documents.size(); i += 4) {
+		search_server.RemoveDocument(documents[i].id);
+		documents[i].id = -1;
+	}
+	documents.erase(remove_if(documents.begin(), documents.end(), [](const TestDocument& document) {
+		return document.id < 0;
+		}), documents.end());
+	check();
+}
+
+void TestChurnCompactsOrdinals() {
+	mt19937 generator(3);
+	const vector<string> dictionary = GenerateDictionary(generator, 40, 2);
+	const string stop_words = dictionary[0];
+	SearchServer search_server(stop_words);
+	vector<TestDocument> live_documents;
+	// Each round replaces most documents, so removed ordinals pile up past
+	// MIN_DEAD_ORDINALS_TO_COMPACT and get renumbered several times.
+	for (int round = 0; round < 6; ++round) {
+		vector<TestDocument> documents = GenerateTestDocuments(generator, dictionary, 800, 8);
+		for (TestDocument& document : documents) {
+			document.id += round * 10000;
+		}
+		AddTestDocuments(search_server, documents);
+		vector<int> removed_ids;
+		for (size_t i = 0; i < live_documents.size(); ++i) {
+			if (i % 8 != 0) {
+				removed_ids.push_back(live_documents[i].id);
+			}
+		}
+		if (round % 2 == 0) {
+			search_server.RemoveDocuments(removed_ids);
+		}
+		else {
+			for (const int document_id : removed_ids) {
+				search_server.RemoveDocument(document_id);
+			}
+		}
+		live_documents.erase(remove_if(live_documents.begin(), live_documents.end(), [&removed_ids](const TestDocument& document) {
+			return binary_search(removed_ids.begin(), removed_ids.end(), document.id);
+			}), live_documents.end());
+		live_documents.insert(live_documents.end(), documents.begin(), documents.end());
+		ASSERT_EQUAL(search_server.GetDocumentCount(), static_cast<int>(live_documents.size()));
+		for (int i = 0; i < 50; ++i) {
+			const string query = GenerateQuery(generator, dictionary, uniform_int_distribution(1, 6)(generator), 0.2);
+			AssertSameDocuments(search_server.FindTopDocuments(query, DocumentStatus::BANNED, 20),
+				FindReferenceTopDocuments(live_documents, stop_words, query, DocumentStatusFilter{ DocumentStatus::BANNED }, 20), query);
+		}
+		for (const TestDocument& document : live_documents) {
+			ASSERT(get<1>(search_server.MatchDocument(dictionary[1], document.id)) == document.status);
+		}
+	}
+}
+
+void TestMaxScoreMatchesExhaustive() {
+	mt19937 generator(2);
+	const vector<string> dictionary = GenerateDictionary(generator, 300, 4);
+	// Zipf-distributed words give the terms very different weights, so MaxScore
+	// actually prunes; the corpus spans several MAX_SCORE_WINDOWs.
+	const ZipfDistribution zipf(dictionary.size(), 1.0);
+	SearchServer search_server(dictionary[0]);
+	const int document_count = 3 * MAX_SCORE_WINDOW;
+	for (int id = 0; id < document_count; ++id) {
+		const DocumentStatus status = id % 7 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+		search_server.AddDocument(id, GenerateQuery(generator, dictionary, uniform_int_distribution(1, 20)(generator), 0, &zipf), status, { id % 11 });
+	}
+	for (int id = 0; id < document_count; id += 5) {
+		search_server.RemoveDocument(id);
+	}
+	const auto has_odd_rating = [](int, DocumentStatus, int rating) {
+		return rating % 2 == 1;
+	};
+	for (int i = 0; i < 300; ++i) {
+		const string query = GenerateQuery(generator, dictionary, uniform_int_distribution(1, 10)(generator), 0.1, i % 2 == 0 ? &zipf : nullptr);
+		for (const size_t top_count : { 1, 5, 20 }) {
+			search_server.SetQueryEvaluation(QueryEvaluation::EXHAUSTIVE);
+			const vector<Document> expected = search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, top_count);
+			const vector<Document> expected_banned = search_server.FindTopDocuments(query, DocumentStatus::BANNED, top_count);
+			const vector<Document> expected_odd = search_server.FindTopDocuments(query, has_odd_rating, top_count);
+			search_server.SetQueryEvaluation(QueryEvaluation::MAX_SCORE);
+			AssertSameDocuments(search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, top_count), expected, query);
+			AssertSameDocuments(search_server.FindTopDocuments(query, DocumentStatus::BANNED, top_count), expected_banned, query);
+			AssertSameDocuments(search_server.FindTopDocuments(query, has_odd_rating, top_count), expected_odd, query);
+		}
+	}
+}
+
+void TestSnapshotRoundTrip() {
+	mt19937 generator(4);
+	const vector<string> dictionary = GenerateDictionary(generator, 60, 3);
+	const string stop_words = dictionary[0];
+	vector<TestDocument> documents = GenerateTestDocuments(generator, dictionary, 500, 10);
+	SearchServer search_server(stop_words);
+	AddTestDocuments(search_server, documents);
+	for (size_t i = 0; i < documents.size(); i += 3) {
+		search_server.RemoveDocument(documents[i].id);
+	}
+	const auto has_even_rating = [](int, DocumentStatus, int rating) {
+		return rating % 2 == 0;
+	};
+	const string path = (filesystem::temp_directory_path() / ("search_server_test_"s + to_string(getpid()) + ".snapshot"s)).string();
+	for (const PostingFormat posting_format : { PostingFormat::RAW, PostingFormat::COMPRESSED }) {
+		search_server.SaveSnapshot(path, posting_format);
+		{
+			const IndexSnapshot snapshot(path);
+			ASSERT_EQUAL(snapshot.GetDocumentCount(), search_server.GetDocumentCount());
+			ASSERT(equal(snapshot.begin(), snapshot.end(), search_server.begin(), search_server.end()));
+			for (int i = 0; i < 200; ++i) {
+				const string query = GenerateQuery(generator, dictionary, uniform_int_distribution(1, 8)(generator), 0.2);
+				for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+					AssertSameDocuments(snapshot.FindTopDocuments(query, status, 10), search_server.FindTopDocuments(query, status, 10), query);
+				}
+				AssertSameDocuments(snapshot.FindTopDocuments(query, has_even_rating), search_server.FindTopDocuments(query, has_even_rating), query);
+			}
+			const string query = dictionary[1] + " "s + dictionary[2] + " -"s + dictionary[3];
+			for (const int document_id : search_server) {
+				const auto [words, status] = snapshot.MatchDocument(query, document_id);
+				const auto [expected_words, expected_status] = search_server.MatchDocument(query, document_id);
+				ASSERT(words == expected_words);
+				ASSERT(status == expected_status);
+			}
+		}
+		filesystem::remove(path);
+	}
+}
+
+void TestSnapshotRejectsCorruption() {
+	mt19937 generator(13);
+	const vector<string> dictionary = GenerateDictionary(generator, 60, 3);
+	const string stop_words = dictionary[0];
+	SearchServer search_server(stop_words);
+	AddTestDocuments(search_server, GenerateTestDocuments(generator, dictionary, 200, 10));
+	const string path = (filesystem::temp_directory_path() / ("search_server_test_"s + to_string(getpid()) + ".snapshot"s)).string();
+	// Saves a snapshot, overwrites the value at an offset given by its header and expects opening to fail.
+	const auto assert_rejected = [&](PostingFormat posting_format, auto get_offset, auto value) {
+		search_server.SaveSnapshot(path, posting_format);
+		SnapshotHeader header;
+		{
+			ifstream in(path, ios::binary);
+			in.read(reinterpret_cast<char*>(&header), sizeof(header));
+		}
+		{
+			fstream out(path, ios::binary | ios::in | ios::out);
+			out.seekp(get_offset(header));
+			out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+		}
+		ASSERT_THROWS(runtime_error, IndexSnapshot snapshot(path));
+		filesystem::remove(path);
+	};
+	for (const PostingFormat posting_format : { PostingFormat::RAW, PostingFormat::COMPRESSED }) {
+		assert_rejected(posting_format, [](const SnapshotHeader& header) {
+			return header.term_bounds + sizeof(uint64_t);
+			}, numeric_limits<uint64_t>::max() / 2);
+		assert_rejected(posting_format, [](const SnapshotHeader& header) {
+			return header.term_posting_bounds + sizeof(uint64_t);
+			}, numeric_limits<uint64_t>::max() / 2);
+		assert_rejected(posting_format, [](const SnapshotHeader& header) {
+			return header.document_term_bounds + sizeof(uint64_t);
+			}, numeric_limits<uint64_t>::max() / 2);
+		assert_rejected(posting_format, [](const SnapshotHeader& header) {
+			return header.document_terms;
+			}, static_cast<int32_t>(search_server.GetDocumentCount() * 100));
+		assert_rejected(posting_format, [](const SnapshotHeader& header) {
+			return header.document_statuses;
+			}, static_cast<int32_t>(DOCUMENT_STATUS_COUNT));
+	}
+	assert_rejected(PostingFormat::RAW, [](const SnapshotHeader& header) {
+		return header.posting_ordinals;
+		}, static_cast<int32_t>(search_server.GetDocumentCount()));
+	assert_rejected(PostingFormat::COMPRESSED, [](const SnapshotHeader& header) {
+		return header.term_posting_byte_bounds + sizeof(uint64_t);
+		}, numeric_limits<uint64_t>::max() / 2);
+	// A first ordinal delta past the last document, then a varint running past its list.
+	assert_rejected(PostingFormat::COMPRESSED, [](const SnapshotHeader& header) {
+		return header.posting_data;
+		}, uint32_t{ 0x7F7FFFFF });
+	assert_rejected(PostingFormat::COMPRESSED, [](const SnapshotHeader& header) {
+		return header.posting_data + header.posting_bytes - 1;
+		}, uint8_t{ 0x80 });
+}
+
+void TestConcurrentPublish() {
+	mt19937 generator(5);
+	const vector<string> dictionary = GenerateDictionary(generator, 40, 2);
+	const string stop_words = dictionary[0];
+	const vector<TestDocument> documents = GenerateTestDocuments(generator, dictionary, 420, 8);
+	ConcurrentSearchServer concurrent_server(stop_words);
+	SearchServer expected_server(stop_words);
+	const auto held_generation = concurrent_server.GetGeneration();
+	atomic<bool> writing = true;
+	vector<thread> readers;
+	for (int reader = 0; reader < 2; ++reader) {
+		readers.emplace_back([&, reader] {
+			mt19937 reader_generator(reader);
+			while (writing) {
+				const auto generation = concurrent_server.GetGeneration();
+				const string query = GenerateQuery(reader_generator, dictionary, 3);
+				for (const Document& document : generation->FindTopDocuments(query)) {
+					generation->MatchDocument(query, document.id);
+				}
+			}
+			});
+	}
+	for (size_t i = 0; i < documents.size(); ++i) {
+		const TestDocument& document = documents[i];
+		concurrent_server.AddDocument(document.id, document.text, document.status, document.ratings);
+		expected_server.AddDocument(document.id, document.text, document.status, document.ratings);
+		if (i % 3 == 0) {
+			concurrent_server.RemoveDocument(document.id);
+			expected_server.RemoveDocument(document.id);
+		}
+		if (i % 50 == 49) {
+			const int published_count = concurrent_server.GetDocumentCount();
+			concurrent_server.Publish();
+			ASSERT_EQUAL(concurrent_server.GetPendingWriteCount(), 0u);
+			ASSERT(concurrent_server.GetDocumentCount() > published_count);
+		}
+	}
+	writing = false;
+	for (thread& reader : readers) {
+		reader.join();
+	}
+	ASSERT(concurrent_server.GetPendingWriteCount() > 0);
+	ASSERT(concurrent_server.GetDocumentCount() < expected_server.GetDocumentCount());
+	concurrent_server.Publish();
+	ASSERT_EQUAL(concurrent_server.GetDocumentCount(), expected_server.GetDocumentCount());
+	ASSERT_EQUAL(held_generation->GetDocumentCount(), 0);
+	for (int i = 0; i < 100; ++i) {
+		const string query = GenerateQuery(generator, dictionary, uniform_int_distribution(1, 6)(generator), 0.2);
+		AssertSameDocuments(concurrent_server.FindTopDocuments(query, DocumentStatus::BANNED, 10), expected_server.FindTopDocuments(query, DocumentStatus::BANNED, 10), query);
+	}
+}
+
+void TestConcurrentFoldMatchesSearchServer() {
+	mt19937 generator(12);
+	const vector<string> dictionary = GenerateDictionary(generator, 80, 3);
+	const string stop_words = dictionary[0];
+	// Enough changes for several folds, some of them racing the writes below.
+	const vector<TestDocument> documents = GenerateTestDocuments(generator, dictionary, 4 * MIN_DELTA_CHANGES_TO_FOLD, 8);
+	ConcurrentSearchServer concurrent_server(stop_words);
+	SearchServer expected_server(stop_words);
+	atomic<bool> writing = true;
+	thread publisher([&] {
+		while (writing) {
+			concurrent_server.Publish();
+		}
+		});
+	vector<int> removed_ids;
+	for (size_t i = 0; i < documents.size(); ++i) {
+		const TestDocument& document = documents[i];
+		concurrent_server.AddDocument(document.id, document.text, document.status, document.ratings);
+		expected_server.AddDocument(document.id, document.text, document.status, document.ratings);
+		// Removes documents from both the base and the delta and re-adds some of them with other text.
+		if (i % 3 == 0) {
+			const int document_id = documents[i * 2 / 3].id;
+			if (expected_server.HasDocument(document_id)) {
+				concurrent_server.RemoveDocument(document_id);
+				expected_server.RemoveDocument(document_id);
+				removed_ids.push_back(document_id);
+			}
+		}
+		if (i % 7 == 0 && !removed_ids.empty()) {
+			const TestDocument& text_source = documents[i / 2];
+			concurrent_server.AddDocument(removed_ids.back(), text_source.text, text_source.status, text_source.ratings);
+			expected_server.AddDocument(removed_ids.back(), text_source.text, text_source.status, text_source.ratings);
+			removed_ids.pop_back();
+		}
+	}
+	writing = false;
+	publisher.join();
+	concurrent_server.Publish();
+	ASSERT(concurrent_server.GetFoldCount() > 0);
+	ASSERT_EQUAL(concurrent_server.GetDocumentCount(), expected_server.GetDocumentCount());
+	const auto generation = concurrent_server.GetGeneration();
+	for (int i = 0; i < 200; ++i) {
+		const string query = GenerateQuery(generator, dictionary, uniform_int_distribution(1, 6)(generator), 0.2);
+		AssertSameDocuments(generation->FindTopDocuments(query, DocumentStatus::BANNED, 10), expected_server.FindTopDocuments(query, DocumentStatus::BANNED, 10), query);
+		AssertSameDocuments(generation->FindTopDocuments(query), expected_server.FindTopDocuments(query), query);
+		const int document_id = documents[i * documents.size() / 200].id;
+		if (expected_server.HasDocument(document_id)) {
+			const auto [words, status] = generation->MatchDocument(query, document_id);
+			const auto [expected_words, expected_status] = expected_server.MatchDocument(query, document_id);
+			ASSERT(words == expected_words);
+			ASSERT(status == expected_status);
+		}
+		else {
+			ASSERT_THROWS(out_of_range, generation->MatchDocument(query, document_id));
+		}
+	}
+}
+
+void TestSegmentedMatchesSearchServer() {
+	mt19937 generator(6);
+	const vector<string> dictionary = GenerateDictionary(generator, 80, 3);
+	const string stop_words = dictionary[0];
+	// Enough documents to seal several segments and have the merger combine them.
+	const vector<TestDocument> documents = GenerateTestDocuments(generator, dictionary, 3 * MUTABLE_SEGMENT_CAPACITY, 10);
+	SegmentedSearchServer segmented_server(stop_words);
+	SearchServer search_server(stop_words);
+	for (size_t i = 0; i < documents.size(); ++i) {
+		const TestDocument& document = documents[i];
+		segmented_server.AddDocument(document.id, document.text, document.status, document.ratings);
+		search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+		if (i % 4 == 3) {
+			segmented_server.RemoveDocument(documents[i - 2].id);
+			search_server.RemoveDocument(documents[i - 2].id);
+		}
+	}
+	ASSERT_THROWS(invalid_argument, segmented_server.RemoveDocument(documents[1].id));
+	ASSERT_THROWS(invalid_argument, segmented_server.RemoveDocument(-1));
+	segmented_server.WaitForMerges();
+	ASSERT_EQUAL(segmented_server.GetDocumentCount(), search_server.GetDocumentCount());
+	const auto has_even_rating = [](int, DocumentStatus, int rating) {
+		return rating % 2 == 0;
+	};
+	for (int i = 0; i < 100; ++i) {
+		const string query = GenerateQuery(generator, dictionary, uniform_int_distribution(1, 6)(generator), 0.2);
+		AssertSameDocuments(segmented_server.FindTopDocuments(query, DocumentStatus::IRRELEVANT, 10), search_server.FindTopDocuments(query, DocumentStatus::IRRELEVANT, 10), query);
+		AssertSameDocuments(segmented_server.FindTopDocuments(execution::par, query), search_server.FindTopDocuments(query), query);
+		AssertSameDocuments(segmented_server.FindTopDocuments(query, has_even_rating), search_server.FindTopDocuments(query, has_even_rating), query);
+	}
+	const string query = dictionary[1] + " "s + dictionary[2] + " -"s + dictionary[3];
+	for (const int document_id : search_server) {
+		ASSERT(segmented_server.MatchDocument(query, document_id) == search_server.MatchDocument(query, document_id));
+	}
+}
+
+void TestQueryCacheInvalidation() {
+	SearchServer search_server("и в на"s);
+	search_server.AddDocument(1, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, { 8, -3 });
+	search_server.AddDocument(2, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	search_server.AddDocument(3, "ухоженный пёс выразительные глаза"s, DocumentStatus::BANNED, { 5, -12, 2, 1 });
+	QueryCache cache(search_server, 16);
+	const auto check = [&](const string& query) {
+		AssertSameDocuments(cache.FindTopDocuments(query), search_server.FindTopDocuments(query), query);
+		AssertSameDocuments(cache.FindTopDocuments(query, DocumentStatus::BANNED), search_server.FindTopDocuments(query, DocumentStatus::BANNED), query);
+		AssertSameDocuments(cache.FindTopDocuments(query, DocumentStatus::ACTUAL, 1), search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 1), query);
+	};
+	check("пушистый кот"s);
+	check("кот пушистый"s);
+	ASSERT(cache.GetStats().hits > 0);
+	search_server.AddDocument(4, "кот кот"s, DocumentStatus::ACTUAL, {});
+	check("пушистый кот"s);
+	search_server.RemoveDocument(2);
+	check("пушистый кот"s);
+
+	// Only the shared stats change here, not the server itself.
+	CorpusStats corpus_stats;
+	for (const int document_id : search_server) {
+		corpus_stats.AddDocument(search_server.GetWordFrequencies(document_id));
+	}
+	search_server.SetCorpusStats(&corpus_stats);
+	check("пушистый кот"s);
+	const uint64_t invalidations = cache.GetStats().invalidations;
+	corpus_stats.AddDocument(vector<string_view>{ "кот"sv, "хвост"sv });
+	corpus_stats.AddDocument(vector<string_view>{ "ошейник"sv });
+	check("пушистый кот"s);
+	ASSERT(cache.GetStats().invalidations > invalidations);
+	search_server.SetCorpusStats(nullptr);
+	check("пушистый кот"s);
+}
+
+void TestDuplicateFinders() {
+	mt19937 generator(7);
+	const vector<string> dictionary = GenerateDictionary(generator, 30, 3);
+	SearchServer search_server(""s);
+	vector<set<string>> word_sets;
+	// Every fifth document repeats an earlier one's words, shuffled and repeated.
+	for (int id = 0; id < 400; ++id) {
+		string text;
+		if (id % 5 == 4) {
+			vector<string> words;
+			for (const auto& [word, term_freq] : search_server.GetWordFrequencies(id - uniform_int_distribution(1, 4)(generator))) {
+				words.push_back(string(word));
+				words.push_back(string(word));
+			}
+			shuffle(words.begin(), words.end(), generator);
+			for (const string& word : words) {
+				text += word + " "s;
+			}
+		}
+		else {
+			text = GenerateQuery(generator, dictionary, uniform_int_distribution(1, 6)(generator));
+		}
+		search_server.AddDocument(id, text, DocumentStatus::ACTUAL, {});
+		const vector<string> words = SplitIntoWords(text);
+		word_sets.emplace_back(words.begin(), words.end());
+	}
+	vector<int> expected;
+	for (size_t id = 0; id < word_sets.size(); ++id) {
+		if (find(word_sets.begin(), word_sets.begin() + id, word_sets[id]) != word_sets.begin() + id) {
+			expected.push_back(static_cast<int>(id));
+		}
+	}
+	ASSERT(!expected.empty());
+	ASSERT(FindDuplicates(search_server) == expected);
+	ASSERT(FindNearDuplicates(search_server, 1.0) == expected);
+
+	const vector<int> near_duplicates = FindNearDuplicates(search_server, 0.5);
+	ASSERT(includes(near_duplicates.begin(), near_duplicates.end(), expected.begin(), expected.end()));
+	const auto jaccard = [&word_sets](int lhs, int rhs) {
+		vector<string> common;
+		set_intersection(word_sets[lhs].begin(), word_sets[lhs].end(), word_sets[rhs].begin(), word_sets[rhs].end(), back_inserter(common));
+		return common.size() * 1.0 / (word_sets[lhs].size() + word_sets[rhs].size() - common.size());
+	};
+	for (const int id : near_duplicates) {
+		bool has_similar = false;
+		for (int other = 0; other < id && !has_similar; ++other) {
+			has_similar = !binary_search(near_duplicates.begin(), near_duplicates.end(), other) && jaccard(id, other) >= 0.5;
+		}
+		ASSERT_HINT(has_similar, to_string(id));
+	}
+
+	DuplicateIndex duplicate_index;
+	SearchServer incremental_server(""s);
+	for (size_t id = 0; id < word_sets.size(); ++id) {
+		string text;
+		for (const string& word : word_sets[id]) {
+			text += word + " "s;
+		}
+		incremental_server.AddDocument(static_cast<int>(id), text, DocumentStatus::ACTUAL, {});
+		const optional<int> original = duplicate_index.Add(incremental_server, static_cast<int>(id));
+		ASSERT_EQUAL(original.has_value(), binary_search(expected.begin(), expected.end(), static_cast<int>(id)));
+		if (original) {
+			ASSERT(word_sets[*original] == word_sets[id]);
+		}
+	}
+
+	ASSERT(RemoveDuplicates(search_server) == expected);
+	ASSERT_EQUAL(search_server.GetDocumentCount(), static_cast<int>(word_sets.size() - expected.size()));
+	ASSERT(FindDuplicates(search_server).empty());
+}
+
+void TestRemoveDocumentsMatchesRemoveDocument() {
+	mt19937 generator(8);
+	const vector<string> dictionary = GenerateDictionary(generator, 50, 3);
+	const string stop_words = dictionary[0];
+	const vector<TestDocument> documents = GenerateTestDocuments(generator, dictionary, 3000, 10);
+	vector<int> removed_ids;
+	for (const TestDocument& document : documents) {
+		if (uniform_int_distribution(0, 2)(generator) != 0) {
+			removed_ids.push_back(document.id);
+		}
+	}
+	shuffle(removed_ids.begin(), removed_ids.end(), generator);
+	// A repeated id is removed once.
+	removed_ids.push_back(removed_ids.front());
+
+	SearchServer one_by_one(stop_words);
+	SearchServer batch_seq(stop_words);
+	SearchServer batch_par(stop_words);
+	for (SearchServer* search_server : { &one_by_one, &batch_seq, &batch_par }) {
+		AddTestDocuments(*search_server, documents);
+	}
+	for (size_t i = 0; i + 1 < removed_ids.size(); ++i) {
+		one_by_one.RemoveDocument(removed_ids[i]);
+	}
+	batch_seq.RemoveDocuments(execution::seq, removed_ids);
+	batch_par.RemoveDocuments(execution::par, removed_ids);
+	ASSERT_THROWS(invalid_argument, batch_seq.RemoveDocuments({ documents[0].id, -5 }));
+
+	for (const SearchServer* search_server : { &batch_seq, &batch_par }) {
+		ASSERT_EQUAL(search_server->GetDocumentCount(), one_by_one.GetDocumentCount());
+		ASSERT(equal(search_server->begin(), search_server->end(), one_by_one.begin(), one_by_one.end()));
+		const IndexStats stats = search_server->GetIndexStats();
+		ASSERT_EQUAL(stats.term_count, one_by_one.GetIndexStats().term_count);
+		ASSERT_EQUAL(stats.posting_count, one_by_one.GetIndexStats().posting_count);
+		for (int i = 0; i < 100; ++i) {
+			const string query = GenerateQuery(generator, dictionary, uniform_int_distribution(1, 6)(generator), 0.2);
+			AssertSameDocuments(search_server->FindTopDocuments(query, DocumentStatus::ACTUAL, 20), one_by_one.FindTopDocuments(query, DocumentStatus::ACTUAL, 20), query);
+		}
+		for (const int document_id : one_by_one) {
+			ASSERT(search_server->GetWordFrequencies(document_id) == one_by_one.GetWordFrequencies(document_id));
+		}
+	}
+}
+
+void TestShardedMatchesSingleServer() {
+	mt19937 generator(9);
+	const vector<string> dictionary = GenerateDictionary(generator, 60, 3);
+	const string stop_words = dictionary[0];
+	const vector<TestDocument> documents = GenerateTestDocuments(generator, dictionary, 1500, 10);
+	const auto has_even_rating = [](int, DocumentStatus, int rating) {
+		return rating % 2 == 0;
+	};
+	for (const size_t shard_count : { 1, 3, 4 }) {
+		ShardedSearchServer sharded_server(stop_words, shard_count);
+		SearchServer search_server(stop_words);
+		for (size_t i = 0; i < documents.size(); ++i) {
+			const TestDocument& document = documents[i];
+			sharded_server.AddDocument(document.id, document.text, document.status, document.ratings);
+			search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+			if (i % 3 == 2) {
+				sharded_server.RemoveDocument(documents[i - 1].id);
+				search_server.RemoveDocument(documents[i - 1].id);
+			}
+		}
+		ASSERT_THROWS(invalid_argument, sharded_server.RemoveDocument(documents[1].id));
+		ASSERT_EQUAL(sharded_server.GetShardCount(), shard_count);
+		ASSERT_EQUAL(sharded_server.GetDocumentCount(), search_server.GetDocumentCount());
+		for (int i = 0; i < 100; ++i) {
+			const string query = GenerateQuery(generator, dictionary, uniform_int_distribution(1, 6)(generator), 0.2);
+			AssertSameDocuments(sharded_server.FindTopDocuments(query), search_server.FindTopDocuments(query), query);
+			AssertSameDocuments(sharded_server.FindTopDocuments(query, DocumentStatus::BANNED, 10), search_server.FindTopDocuments(query, DocumentStatus::BANNED, 10), query);
+			AssertSameDocuments(sharded_server.FindTopDocuments(query, has_even_rating), search_server.FindTopDocuments(query, has_even_rating), query);
+		}
+		const string query = dictionary[1] + " "s + dictionary[2] + " -"s + dictionary[3];
+		for (const int document_id : search_server) {
+			ASSERT(sharded_server.MatchDocument(query, document_id) == search_server.MatchDocument(query, document_id));
+		}
+	}
+}
+
+// Starts shard_count processes of this program in shard mode and returns their sockets.
+vector<string> StartShardProcesses(const string& stop_words, size_t shard_count, vector<pid_t>& processes) {
+	vector<string> socket_paths;
+	for (size_t shard = 0; shard < shard_count; ++shard) {
+		socket_paths.push_back((filesystem::temp_directory_path() / ("search_shard_test_"s + to_string(getpid()) + "_"s + to_string(shard) + ".sock"s)).string());
+		const string mode = "--shard"s;
+		char* const arguments[] = { const_cast<char*>("search_server"), const_cast<char*>(mode.c_str()), const_cast<char*>(socket_paths.back().c_str()), const_cast<char*>(stop_words.c_str()), nullptr };
+		pid_t process;
+		ASSERT(posix_spawn(&process, "/proc/self/exe", nullptr, nullptr, arguments, environ) == 0);
+		processes.push_back(process);
+	}
+	return socket_paths;
+}
+
+void StopShardProcesses(ShardRouter& router, const vector<pid_t>& processes) {
+	router.Shutdown();
+	for (const pid_t process : processes) {
+		int status = 0;
+		ASSERT(waitpid(process, &status, 0) == process);
+		ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	}
+}
+
+void TestShardProcessesMatchSingleServer() {
+	mt19937 generator(10);
+	const vector<string> dictionary = GenerateDictionary(generator, 60, 3);
+	const string stop_words = dictionary[0];
+	const vector<TestDocument> documents = GenerateTestDocuments(generator, dictionary, 600, 10);
+	vector<pid_t> processes;
+	ShardRouter router(StartShardProcesses(stop_words, 3, processes), chrono::seconds(10));
+	SearchServer search_server(stop_words);
+	for (size_t i = 0; i < documents.size(); ++i) {
+		const TestDocument& document = documents[i];
+		router.AddDocument(document.id, document.text, document.status, document.ratings);
+		search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+		if (i % 3 == 2) {
+			router.RemoveDocument(documents[i - 1].id);
+			search_server.RemoveDocument(documents[i - 1].id);
+		}
+	}
+	ASSERT_THROWS(invalid_argument, router.AddDocument(documents[0].id, "x"s, DocumentStatus::ACTUAL, {}));
+	ASSERT_THROWS(invalid_argument, router.RemoveDocument(documents[1].id));
+	ASSERT_THROWS(out_of_range, router.MatchDocument(dictionary[1], documents[1].id));
+	ASSERT_THROWS(invalid_argument, router.FindTopDocuments("a\x01b"s));
+	ASSERT_EQUAL(router.GetDocumentCount(), search_server.GetDocumentCount());
+	for (int i = 0; i < 50; ++i) {
+		const string query = GenerateQuery(generator, dictionary, uniform_int_distribution(1, 6)(generator), 0.2);
+		AssertSameDocuments(router.FindTopDocuments(query), search_server.FindTopDocuments(query), query);
+		AssertSameDocuments(router.FindTopDocuments(query, DocumentStatus::BANNED, 10), search_server.FindTopDocuments(query, DocumentStatus::BANNED, 10), query);
+	}
+	const string query = dictionary[1] + " "s + dictionary[2] + " -"s + dictionary[3];
+	for (const int document_id : search_server) {
+		const auto [words, status] = router.MatchDocument(query, document_id);
+		const auto [expected_words, expected_status] = search_server.MatchDocument(query, document_id);
+		ASSERT(words == vector<string>(expected_words.begin(), expected_words.end()));
+		ASSERT(status == expected_status);
+	}
+	ASSERT_EQUAL(router.GetTimeoutCount(), 0u);
+	StopShardProcesses(router, processes);
+}
+
+void TestShardRouterFailsShardAfterLostWrite() {
+	vector<pid_t> processes;
+	ShardRouter router(StartShardProcesses(""s, 2, processes), chrono::milliseconds(300));
+	router.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+	// A stopped shard reads the write only after the router gave up on it.
+	ASSERT(kill(processes[0], SIGSTOP) == 0);
+	ASSERT_THROWS(runtime_error, router.AddDocument(2, "black cat"s, DocumentStatus::ACTUAL, { 2 }));
+	ASSERT(kill(processes[0], SIGCONT) == 0);
+	ASSERT_EQUAL(router.GetFailedShardCount(), 1u);
+	ASSERT_THROWS(runtime_error, router.AddDocument(4, "grey cat"s, DocumentStatus::ACTUAL, { 4 }));
+	ASSERT_THROWS(runtime_error, router.MatchDocument("cat"s, 2));
+	router.AddDocument(3, "black dog"s, DocumentStatus::ACTUAL, { 3 });
+	const vector<Document> documents = router.FindTopDocuments("cat dog"s);
+	ASSERT_EQUAL(documents.size(), 2u);
+	ASSERT_EQUAL(documents[0].id + documents[1].id, 4);
+	ASSERT_EQUAL(router.GetTimeoutCount(), 0u);
+	StopShardProcesses(router, processes);
+}
+
+void TestShardServerRejectsBadStatus() {
+	vector<pid_t> processes;
+	const vector<string> socket_paths = StartShardProcesses(""s, 1, processes);
+	const int socket = ConnectUnixSocket(socket_paths[0], SHARD_CONNECT_TIMEOUT);
+	ASSERT(socket >= 0);
+	const auto call = [socket](ShardRequest request_type, const MessageWriter& request) {
+		uint8_t type;
+		vector<char> payload;
+		ASSERT(SendMessage(socket, static_cast<uint8_t>(request_type), request.GetPayload()));
+		ASSERT(ReceiveMessage(socket, type, payload));
+		return static_cast<ShardResponse>(type);
+	};
+	for (const int32_t status : { -1, static_cast<int32_t>(DOCUMENT_STATUS_COUNT), 1000 }) {
+		MessageWriter add;
+		add.WriteInt32(1);
+		add.WriteInt32(status);
+		add.WriteString("cat"sv);
+		add.WriteUint32(0);
+		ASSERT(call(ShardRequest::ADD_DOCUMENT, add) == ShardResponse::INVALID_ARGUMENT);
+		MessageWriter find;
+		find.WriteString("cat"sv);
+		find.WriteInt32(status);
+		find.WriteUint32(5);
+		find.WriteInt32(1);
+		find.WriteUint32(0);
+		ASSERT(call(ShardRequest::FIND_TOP_DOCUMENTS, find) == ShardResponse::INVALID_ARGUMENT);
+	}
+	ASSERT(SendMessage(socket, static_cast<uint8_t>(ShardRequest::SHUTDOWN), {}));
+	close(socket);
+	int exit_status = 0;
+	ASSERT(waitpid(processes[0], &exit_status, 0) == processes[0]);
+	ASSERT(WIFEXITED(exit_status) && WEXITSTATUS(exit_status) == 0);
+}
+
+void TestCorpusStatsMissingLocalWord() {
+	SearchServer search_server(""s);
+	search_server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+	search_server.AddDocument(2, "black dog"s, DocumentStatus::ACTUAL, { 2 });
+	CorpusStats corpus_stats;
+	corpus_stats.SetDocumentCount(10);
+	corpus_stats.SetDocumentFreq("cat"sv, 5);
+	corpus_stats.SetDocumentFreq("white"sv, 0);
+	// "cat" uses the stats; "white" (counted nowhere) and "dog" (missing) use the local IDF.
+	const vector<Document> expected = { { 1, 0.5 * log(10.0 / 5) + 0.5 * log(2.0), 1 }, { 2, 0.5 * log(2.0), 2 } };
+	AssertSameDocuments(search_server.FindTopDocuments("white cat dog"s, DocumentStatusFilter{ DocumentStatus::ACTUAL }, 5, corpus_stats), expected, "per query"s);
+	search_server.SetCorpusStats(&corpus_stats);
+	AssertSameDocuments(search_server.FindTopDocuments("white cat dog"s), expected, "attached"s);
+	search_server.SetCorpusStats(nullptr);
+}
+
+void TestQueryExecutorNestedBatches() {
+	QueryExecutor executor(4);
+	const size_t task_count = 200;
+	const size_t nested_task_count = 8;
+	// Two outside threads run batches whose tasks run nested batches, some of
+	// which throw; every task still runs before the exception reaches the caller.
+	vector<size_t> sums(2);
+	vector<thread> callers;
+	for (size_t caller = 0; caller < sums.size(); ++caller) {
+		callers.emplace_back([&, caller] {
+			atomic<size_t> sum = 0;
+			executor.ParallelFor(task_count, [&](size_t i) {
+				try {
+					executor.ParallelFor(nested_task_count, [&](size_t j) {
+						if (i % 50 == 7 && j == 3) {
+							throw invalid_argument("nested");
+						}
+						sum += i * nested_task_count + j;
+						});
+				}
+				catch (const invalid_argument&) {
+					sum += 1'000'000;
+				}
+				});
+			sums[caller] = sum;
+			});
+	}
+	for (thread& caller : callers) {
+		caller.join();
+	}
+	size_t expected_sum = task_count * nested_task_count * (task_count * nested_task_count - 1) / 2;
+	for (size_t i = 7; i < task_count; i += 50) {
+		expected_sum += 1'000'000 - (i * nested_task_count + 3);
+	}
+	for (const size_t sum : sums) {
+		ASSERT_EQUAL(sum, expected_sum);
+	}
+}
+
+void TestProcessQueriesJoinedStreamsInOrder() {
+	mt19937 generator(14);
+	const vector<string> dictionary = GenerateDictionary(generator, 60, 3);
+	const string stop_words = dictionary[0];
+	SearchServer search_server(stop_words);
+	AddTestDocuments(search_server, GenerateTestDocuments(generator, dictionary, 300, 10));
+	// Enough queries for the sink to overlap several windows.
+	vector<string> queries;
+	for (size_t i = 0; i < 2 * PROCESS_QUERIES_WINDOW + 100; ++i) {
+		queries.push_back(GenerateQuery(generator, dictionary, uniform_int_distribution(1, 4)(generator), 0.1));
+	}
+	QueryExecutor executor(3);
+	size_t next_index = 0;
+	ProcessQueriesJoined(executor, search_server, queries, [&](size_t query_index, const vector<Document>& documents) {
+		ASSERT_EQUAL(query_index, next_index);
+		AssertSameDocuments(documents, search_server.FindTopDocuments(queries[query_index]), queries[query_index]);
+		++next_index;
+		});
+	ASSERT_EQUAL(next_index, queries.size());
+}
+
+void TestSearchServer() {
+	RUN_TEST(TestExcludeStopWordsFromAddedDocumentContent);
+	RUN_TEST(TestMinusWordsExcludeDocuments);
+	RUN_TEST(TestMatchDocument);
+	RUN_TEST(TestRelevanceRatingAndSorting);
+	RUN_TEST(TestStatusAndPredicate);
+	RUN_TEST(TestRemoveDocument);
+	RUN_TEST(TestInvalidInput);
+	RUN_TEST(TestMatchesReferenceRanking);
+	RUN_TEST(TestChurnCompactsOrdinals);
+	RUN_TEST(TestMaxScoreMatchesExhaustive);
+	RUN_TEST(TestSnapshotRoundTrip);
+	RUN_TEST(TestSnapshotRejectsCorruption);
+	RUN_TEST(TestConcurrentPublish);
+	RUN_TEST(TestConcurrentFoldMatchesSearchServer);
+	RUN_TEST(TestSegmentedMatchesSearchServer);
+	RUN_TEST(TestQueryCacheInvalidation);
+	RUN_TEST(TestDuplicateFinders);
+	RUN_TEST(TestRemoveDocumentsMatchesRemoveDocument);
+	RUN_TEST(TestShardedMatchesSingleServer);
+	RUN_TEST(TestShardProcessesMatchSingleServer);
+	RUN_TEST(TestShardRouterFailsShardAfterLostWrite);
+	RUN_TEST(TestCorpusStatsMissingLocalWord);
+	RUN_TEST(TestShardServerRejectsBadStatus);
+	RUN_TEST(TestQueryExecutorNestedBatches);
+	RUN_TEST(TestProcessQueriesJoinedStreamsInOrder);
+}
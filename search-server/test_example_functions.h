@@ -1 +1,56 @@
 #pragma once
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+template <typename T, typename U>
+void AssertEqualImpl(const T& t, const U& u, const std::string& t_str, const std::string& u_str, const std::string& file,
+	const std::string& func, unsigned line, const std::string& hint) {
+	if (t != u) {
+		std::cerr << std::boolalpha;
+		std::cerr << file << "(" << line << "): " << func << ": ";
+		std::cerr << "ASSERT_EQUAL(" << t_str << ", " << u_str << ") failed: ";
+		std::cerr << t << " != " << u << ".";
+		if (!hint.empty()) {
+			std::cerr << " Hint: " << hint;
+		}
+		std::cerr << std::endl;
+		std::abort();
+	}
+}
+
+#define ASSERT_EQUAL(a, b) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, "")
+
+#define ASSERT_EQUAL_HINT(a, b, hint) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, (hint))
+
+void AssertImpl(bool value, const std::string& expr_str, const std::string& file, const std::string& func, unsigned line, const std::string& hint);
+
+#define ASSERT(expr) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, "")
+
+#define ASSERT_HINT(expr, hint) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, (hint))
+
+template <typename Exception, typename Call>
+void AssertThrowsImpl(Call call, const std::string& call_str, const std::string& file, const std::string& func, unsigned line) {
+	try {
+		call();
+	}
+	catch (const Exception&) {
+		return;
+	}
+	catch (...) {
+	}
+	AssertImpl(false, "throws " + call_str, file, func, line, "");
+}
+
+#define ASSERT_THROWS(exception, call) AssertThrowsImpl<exception>([&] { call; }, #call, __FILE__, __FUNCTION__, __LINE__)
+
+template <typename TestFunc>
+void RunTestImpl(const TestFunc& func, const std::string& test_name) {
+	func();
+	std::cerr << test_name << " OK" << std::endl;
+}
+
+#define RUN_TEST(func) RunTestImpl(func, #func)
+
+// Runs every test; a failed check prints where it failed and aborts.
+void TestSearchServer();
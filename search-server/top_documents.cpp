@@ -0,0 +1,87 @@
+#include "top_documents.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <thread>
+
+const size_t MIN_DOCUMENTS_PER_CHUNK = 4096;
+
+bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+	if (std::abs(lhs.relevance - rhs.relevance) < RELEVANCE_ROUNDING) {
+		if (lhs.rating == rhs.rating) {
+			return lhs.id < rhs.id;
+		}
+		return lhs.rating > rhs.rating;
+	}
+	return lhs.relevance > rhs.relevance;
+}
+
+TopDocuments::TopDocuments(size_t top_count)
+	: top_count_(top_count) {
+	heap_.reserve(top_count_);
+}
+
+void TopDocuments::Add(const Document& document) {
+	if (heap_.size() < top_count_) {
+		heap_.push_back(document);
+		std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+	}
+	else if (top_count_ > 0 && IsMoreRelevant(document, heap_.front())) {
+		std::pop_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+		heap_.back() = document;
+		std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+	}
+}
+
+void TopDocuments::Merge(const TopDocuments& other) {
+	for (const Document& document : other.heap_) {
+		Add(document);
+	}
+}
+
+bool TopDocuments::IsFull() const {
+	return heap_.size() >= top_count_;
+}
+
+const Document& TopDocuments::GetWorst() const {
+	return heap_.front();
+}
+
+std::vector<Document> TopDocuments::Extract() {
+	std::sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+	return std::move(heap_);
+}
+
+std::vector<Document> SelectTopDocuments(const std::vector<Document>& documents, size_t top_count) {
+	TopDocuments top_documents(top_count);
+	for (const Document& document : documents) {
+		top_documents.Add(document);
+	}
+	return top_documents.Extract();
+}
+
+std::vector<Document> SelectTopDocuments(std::execution::sequenced_policy, const std::vector<Document>& documents, size_t top_count) {
+	return SelectTopDocuments(documents, top_count);
+}
+
+std::vector<Document> SelectTopDocuments(std::execution::parallel_policy, const std::vector<Document>& documents, size_t top_count) {
+	const size_t chunk_count = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), documents.size() / MIN_DOCUMENTS_PER_CHUNK + 1);
+	if (chunk_count == 1) {
+		return SelectTopDocuments(documents, top_count);
+	}
+	const size_t chunk_size = (documents.size() + chunk_count - 1) / chunk_count;
+	std::vector<TopDocuments> chunk_tops(chunk_count, TopDocuments(top_count));
+	std::vector<size_t> chunks(chunk_count);
+	std::iota(chunks.begin(), chunks.end(), 0);
+	std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](size_t chunk) {
+		const size_t end = std::min(documents.size(), (chunk + 1) * chunk_size);
+		for (size_t i = chunk * chunk_size; i < end; ++i) {
+			chunk_tops[chunk].Add(documents[i]);
+		}
+		});
+	for (size_t chunk = 1; chunk < chunk_count; ++chunk) {
+		chunk_tops[0].Merge(chunk_tops[chunk]);
+	}
+	return chunk_tops[0].Extract();
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "document.h"
+
+#include <execution>
+#include <vector>
+
+const double RELEVANCE_ROUNDING = 1e-6;
+
+bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
+class TopDocuments {
+public:
+	explicit TopDocuments(size_t top_count);
+
+	void Add(const Document& document);
+
+	void Merge(const TopDocuments& other);
+
+	bool IsFull() const;
+
+	const Document& GetWorst() const;
+
+	std::vector<Document> Extract();
+
+private:
+	size_t top_count_;
+	std::vector<Document> heap_;
+};
+
+std::vector<Document> SelectTopDocuments(const std::vector<Document>& documents, size_t top_count);
+
+std::vector<Document> SelectTopDocuments(std::execution::sequenced_policy, const std::vector<Document>& documents, size_t top_count);
+
+std::vector<Document> SelectTopDocuments(std::execution::parallel_policy, const std::vector<Document>& documents, size_t top_count);